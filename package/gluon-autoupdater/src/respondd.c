@@ -64,7 +64,7 @@ static struct json_object * get_autoupdater(void) {
 	return NULL;
 }
 
-static struct json_object * respondd_provider_nodeinfo(void) {
+static struct json_object * get_nodeinfo(void) {
 	struct json_object *ret = json_object_new_object();
 
 	struct json_object *software = json_object_new_object();
@@ -74,6 +74,19 @@ static struct json_object * respondd_provider_nodeinfo(void) {
 	return ret;
 }
 
+static struct json_object * respondd_provider_nodeinfo(void) {
+	static const char *const files[] = {
+		"/etc/config/autoupdater",
+		NULL,
+	};
+	static struct gluonutil_json_cache cache = {
+		.ttl = GLUONUTIL_JSON_CACHE_TTL,
+		.files = files,
+	};
+
+	return gluonutil_json_cache_get(&cache, get_nodeinfo);
+}
+
 
 const struct respondd_provider_info respondd_providers[] = {
 	{"nodeinfo", respondd_provider_nodeinfo},
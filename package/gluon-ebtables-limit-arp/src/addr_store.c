@@ -6,109 +6,135 @@
  */
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "addr_store.h"
-#include "gluon-arp-limiter.h"
 #include "lookup3.h"
 
-static struct addr_list *addr_node_alloc(void *addr,
-					 struct addr_store *store)
-{
-	struct addr_list *node;
-	size_t addr_len = store->addr_len;
+struct addr_slot {
+	int used;
+	int tic;
+	/* addr_len bytes, aligned for hashword() */
+	uint32_t addr[0];
+};
 
-	node = malloc(sizeof(struct addr_list) + addr_len);
-	if (!node)
-		return NULL;
+static struct addr_slot *addr_slot_get(struct addr_store *store, size_t idx)
+{
+	return (struct addr_slot *)(store->slots + idx * store->slot_len);
+}
 
-	memcpy(node->addr, addr, addr_len);
-	node->next = NULL;
-	node->tic = clock;
+static size_t addr_store_hash(void *addr, struct addr_store *store)
+{
+	int len = store->addr_len / sizeof(uint32_t);
 
-	return node;
+	return hashword(addr, len, 0) & (store->num_slots - 1);
 }
 
-static struct addr_list *addr_list_search(void *addr,
-					  size_t addr_len,
-					  struct addr_list *list)
+/*
+ * Returns the slot holding addr, or the free slot where it would have to be
+ * inserted.
+ */
+static struct addr_slot *addr_store_lookup(void *addr,
+					   struct addr_store *store)
 {
-	struct addr_list *node = list;
-	struct addr_list *ret = NULL;
+	size_t mask = store->num_slots - 1;
+	size_t idx = addr_store_hash(addr, store);
+	struct addr_slot *slot;
 
-	if (!node)
-		goto out;
+	/* terminates as the table is never full */
+	while (1) {
+		slot = addr_slot_get(store, idx);
 
-	do {
-		// Found it!
-		if (!memcmp(node->addr, addr, addr_len)) {
-			ret = node;
-			break;
-		}
+		if (!slot->used)
+			return slot;
 
-		node = node->next;
-	} while (node);
+		// Found it!
+		if (!memcmp(slot->addr, addr, store->addr_len))
+			return slot;
 
-out:
-	return ret;
+		idx = (idx + 1) & mask;
+	}
 }
 
-static void addr_list_add(struct addr_list *node, struct addr_list **list)
+static int addr_store_alloc_slots(size_t num_slots, struct addr_store *store)
 {
-	node->next = *list;
-	*list = node;
+	char *slots = calloc(num_slots, store->slot_len);
+
+	if (!slots) {
+		printf("Error: Out of memory\n");
+		return -ENOMEM;
+	}
+
+	store->slots = slots;
+	store->num_slots = num_slots;
+
+	return 0;
 }
 
-static struct addr_list **addr_store_get_bucket(void *addr,
-						struct addr_store *store)
+static int addr_store_resize(size_t num_slots, struct addr_store *store)
 {
-	int len = store->addr_len / sizeof(uint32_t);
-	int idx;
-	uint32_t ret;
+	char *old_slots = store->slots;
+	size_t old_num_slots = store->num_slots;
+	struct addr_slot *old, *new;
+	size_t i;
+	int ret;
+
+	ret = addr_store_alloc_slots(num_slots, store);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < old_num_slots; i++) {
+		old = (struct addr_slot *)(old_slots + i * store->slot_len);
+		if (!old->used)
+			continue;
+
+		new = addr_store_lookup(old->addr, store);
+		memcpy(new, old, store->slot_len);
+	}
 
-	ret = hashword(addr, len, 0);
-	idx = ret % ADDR_STORE_NUM_BUCKETS;
+	free(old_slots);
 
-	return &store->buckets[idx];
+	return 0;
 }
 
 int addr_store_add(void *addr, struct addr_store *store)
 {
-	struct addr_list **bucket = addr_store_get_bucket(addr, store);
-	struct addr_list *node = addr_list_search(addr, store->addr_len,
-						  *bucket);
+	struct addr_slot *slot = addr_store_lookup(addr, store);
 
-	if (node) {
-		node->tic = clock;
+	if (slot->used) {
+		slot->tic = store->tic;
 		return -EEXIST;
 	}
 
-	node = addr_node_alloc(addr, store);
-	if (!node) {
-		printf("Error: Out of memory\n");
-		return -ENOMEM;
+	/* keep the load factor at or below 3/4 */
+	if ((store->num_entries + 1) * 4 > store->num_slots * 3) {
+		if (addr_store_resize(store->num_slots * 2, store))
+			return -ENOMEM;
+
+		slot = addr_store_lookup(addr, store);
 	}
 
-	addr_list_add(node, bucket);
+	slot->used = 1;
+	slot->tic = store->tic;
+	memcpy(slot->addr, addr, store->addr_len);
+	store->num_entries++;
+
 	return 0;
 }
 
 int addr_store_init(size_t addr_len,
-		    void (*destructor)(struct addr_list *),
 		    char *(*ntoa)(void *),
 		    struct addr_store *store)
 {
-	int i;
-
+	store->tic = 0;
 	store->addr_len = addr_len;
-	store->destructor = destructor;
+	store->slot_len = sizeof(struct addr_slot) + addr_len;
+	store->num_entries = 0;
 	store->ntoa = ntoa;
 
-	for (i = 0; i < ADDR_STORE_NUM_BUCKETS; i++)
-		store->buckets[i] = NULL;
-
-	return 0;
+	return addr_store_alloc_slots(ADDR_STORE_MIN_SLOTS, store);
 }
 
 static char *addr_ntoa(void *addr, struct addr_store *store)
@@ -116,52 +142,113 @@ static char *addr_ntoa(void *addr, struct addr_store *store)
 	return store->ntoa(addr);
 }
 
-static void addr_store_dump(struct addr_store *store)
+void addr_store_dump(struct addr_store *store)
 {
-	int i;
-	struct addr_list *node;
+	struct addr_slot *slot;
+	size_t i;
 
-	for (i = 0; i < ADDR_STORE_NUM_BUCKETS; i++) {
-		node = store->buckets[i];
+	printf("%zu entries in %zu slots:\n", store->num_entries,
+	       store->num_slots);
 
-		if (node)
-			printf("Bucket #%i:\n", i);
+	for (i = 0; i < store->num_slots; i++) {
+		slot = addr_slot_get(store, i);
 
-		while (node) {
-			printf("\t%s\n", addr_ntoa(node->addr, store));
-			node = node->next;
-		}
+		if (slot->used)
+			printf("\t%s\n", addr_ntoa(slot->addr, store));
 	}
 }
 
-void addr_store_cleanup(struct addr_store *store)
+/*
+ * Calls cb for every stored address, stopping at the first non-zero return
+ * value, which is returned.
+ */
+int addr_store_foreach(struct addr_store *store,
+		       int (*cb)(void *addr, void *arg), void *arg)
 {
-	struct addr_list *node, *prev;
-	int i;
-
-	for (i = 0; i < ADDR_STORE_NUM_BUCKETS; i++) {
-		node = store->buckets[i];
-		prev = NULL;
-
-		while (node) {
-			if (node->tic != clock) {
-				store->destructor(node);
-
-				if (prev) {
-					prev->next = node->next;
-					free(node);
-					node = prev->next;
-				} else {
-					store->buckets[i] = node->next;
-					free(node);
-					node = store->buckets[i];
-				}
-			} else {
-				prev = node;
-				node = node->next;
-			}
+	struct addr_slot *slot;
+	size_t i;
+	int ret;
+
+	for (i = 0; i < store->num_slots; i++) {
+		slot = addr_slot_get(store, i);
+		if (!slot->used)
+			continue;
+
+		ret = cb(slot->addr, arg);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Empties the slot idx by moving later entries of the same probe sequence
+ * back, so that every entry stays reachable from its home slot.
+ */
+static void addr_store_delete(size_t idx, struct addr_store *store)
+{
+	size_t mask = store->num_slots - 1;
+	struct addr_slot *hole = addr_slot_get(store, idx);
+	struct addr_slot *slot;
+	size_t next = idx;
+	size_t home;
+
+	while (1) {
+		next = (next + 1) & mask;
+		slot = addr_slot_get(store, next);
+
+		if (!slot->used)
+			break;
+
+		/* entries with their home slot cyclically in (idx, next]
+		 * can't be moved in front of it
+		 */
+		home = addr_store_hash(slot->addr, store);
+		if (((next - home) & mask) < ((next - idx) & mask))
+			continue;
+
+		memcpy(hole, slot, store->slot_len);
+		hole = slot;
+		idx = next;
+	}
+
+	hole->used = 0;
+	store->num_entries--;
+}
+
+/*
+ * Removes all entries which have not been added again since the last
+ * cleanup and starts a new update cycle.
+ *
+ * Returns the number of removed entries.
+ */
+int addr_store_cleanup(struct addr_store *store)
+{
+	struct addr_slot *slot;
+	int removed = 0;
+	size_t i = 0;
+
+	while (i < store->num_slots) {
+		slot = addr_slot_get(store, i);
+
+		if (slot->used && slot->tic != store->tic) {
+			addr_store_delete(i, store);
+			removed++;
+
+			/* another entry may have been moved into this slot */
+			continue;
 		}
+
+		i++;
 	}
 
-	addr_store_dump(store);
+	/* shrink again after a mass expiry, failing to do so is harmless */
+	if (store->num_slots > ADDR_STORE_MIN_SLOTS &&
+	    store->num_entries * 8 < store->num_slots)
+		addr_store_resize(store->num_slots / 2, store);
+
+	store->tic++;
+
+	return removed;
 }
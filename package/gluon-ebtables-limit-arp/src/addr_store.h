@@ -8,26 +8,36 @@
 #ifndef _ADDR_STORE_H_
 #define _ADDR_STORE_H_
 
-#define ADDR_STORE_NUM_BUCKETS 32
+#include <stddef.h>
 
-struct addr_list {
-	struct addr_list *next;
-	int tic;
-	char addr[0];
-};
+/* initial number of slots, must be a power of two */
+#define ADDR_STORE_MIN_SLOTS 32
 
+/*
+ * Open addressing hash table with linear probing. The addresses are stored
+ * inline in the slot array, so a lookup usually touches a single cache
+ * line. Deleted entries are closed by shifting the following entries of
+ * their probe sequence back, so no tombstones are needed.
+ */
 struct addr_store {
-	struct addr_list *buckets[ADDR_STORE_NUM_BUCKETS];
+	/* num_slots slots of slot_len bytes, see struct addr_slot */
+	char *slots;
+	size_t num_slots;
+	size_t num_entries;
+	size_t slot_len;
+	/* current update cycle, entries not seen in it are removed */
+	int tic;
 	size_t addr_len;
-	void (*destructor)(struct addr_list *);
 	char *(*ntoa)(void *);
 };
 
 int addr_store_init(size_t addr_len,
-		    void (*destructor)(struct addr_list *),
 		    char *(*ntoa)(void *),
 		    struct addr_store *store);
 int addr_store_add(void *addr, struct addr_store *store);
-void addr_store_cleanup(struct addr_store *store);
+int addr_store_cleanup(struct addr_store *store);
+int addr_store_foreach(struct addr_store *store,
+		       int (*cb)(void *addr, void *arg), void *arg);
+void addr_store_dump(struct addr_store *store);
 
 #endif /* _ADDR_STORE_H_ */
@@ -0,0 +1,160 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0+
+ * License-Filename: LICENSE
+ */
+
+/*
+ * Micro-benchmark of the address store, built on the host with "make bench"
+ *
+ * For each store size, the time per entry is measured for adding new
+ * addresses, looking up (re-adding) known addresses, sweeping a store in
+ * which all addresses have been seen, and sweeping a store in which half of
+ * the addresses have expired.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "addr_store.h"
+#include "mac.h"
+
+/* repetitions of each measurement, the fastest one is reported */
+#define BENCH_RUNS 5
+
+static const size_t bench_sizes[] = { 10000, 100000 };
+
+static char *bench_ntoa(void *addr)
+{
+	(void)addr;
+	return "";
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* xorshift, so the addresses are the same in every run */
+static uint64_t bench_random(void)
+{
+	static uint64_t x = 88172645463325252ULL;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return x;
+}
+
+static void fill_addrs(struct mac_addr *addrs, size_t num)
+{
+	uint64_t r;
+	size_t i;
+
+	for (i = 0; i < num; i++) {
+		r = bench_random();
+		memset(&addrs[i], 0, sizeof(addrs[i]));
+		memcpy(addrs[i].storage, &r, 6);
+		/* unicast, like the source addresses of the local clients */
+		addrs[i].storage[0] &= ~0x01;
+	}
+}
+
+static int add_all(struct addr_store *store, struct mac_addr *addrs,
+		   size_t num, size_t step)
+{
+	int added = 0;
+	size_t i;
+
+	for (i = 0; i < num; i += step) {
+		if (!addr_store_add(&addrs[i], store))
+			added++;
+	}
+
+	return added;
+}
+
+static void free_store(struct addr_store *store)
+{
+	free(store->slots);
+}
+
+static void bench(size_t num)
+{
+	double best_add = 1e9, best_lookup = 1e9, best_sweep = 1e9, best_expire = 1e9;
+	struct mac_addr *addrs = calloc(num, sizeof(*addrs));
+	struct addr_store store;
+	double t;
+	int run;
+
+	if (!addrs) {
+		fprintf(stderr, "Error: Out of memory\n");
+		exit(1);
+	}
+
+	fill_addrs(addrs, num);
+
+	for (run = 0; run < BENCH_RUNS; run++) {
+		if (addr_store_init(sizeof(struct mac_addr), bench_ntoa, &store))
+			exit(1);
+
+		t = now();
+		add_all(&store, addrs, num, 1);
+		t = now() - t;
+		if (t < best_add)
+			best_add = t;
+
+		addr_store_cleanup(&store);
+
+		t = now();
+		add_all(&store, addrs, num, 1);
+		t = now() - t;
+		if (t < best_lookup)
+			best_lookup = t;
+
+		t = now();
+		addr_store_cleanup(&store);
+		t = now() - t;
+		if (t < best_sweep)
+			best_sweep = t;
+
+		/* only every second address is seen again */
+		add_all(&store, addrs, num, 2);
+
+		t = now();
+		addr_store_cleanup(&store);
+		t = now() - t;
+		if (t < best_expire)
+			best_expire = t;
+
+		if (store.num_entries != (num + 1) / 2) {
+			fprintf(stderr, "Error: %zu entries left after sweep, expected %zu\n",
+				store.num_entries, (num + 1) / 2);
+			exit(1);
+		}
+
+		free_store(&store);
+	}
+
+	printf("%7zu entries: add %6.1f ns, lookup %6.1f ns, sweep %6.1f ns, "
+	       "sweep with expiry %6.1f ns (per entry)\n", num,
+	       best_add * 1e9 / num, best_lookup * 1e9 / num,
+	       best_sweep * 1e9 / num, best_expire * 1e9 / num);
+
+	free(addrs);
+}
+
+int main(void)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++)
+		bench(bench_sizes[i]);
+
+	return 0;
+}
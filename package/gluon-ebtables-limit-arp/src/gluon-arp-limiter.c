@@ -7,23 +7,42 @@
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <linux/if_ether.h>
 #include <netinet/in.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+
+#include <netlink/netlink.h>
+#include <netlink/genl/genl.h>
+#include <batadv-genl.h>
+#include <libgluonutil-ebtables.h>
+
+#include <linux/netfilter_bridge/ebt_arp.h>
+#include <linux/netfilter_bridge/ebt_limit.h>
+#include <linux/netfilter_bridge/ebt_mark_t.h>
+
 #include "addr_store.h"
-#include "gluon-arp-limiter.h"
 #include "mac.h"
 
-#define BATCTL_DC "/usr/sbin/batctl dc -H -n"
-#define BATCTL_TL "/usr/sbin/batctl tl -H -n"
-#define EBTABLES "/usr/sbin/ebtables-tiny"
+#define MESH_IFACE "bat0"
 
 #define BUILD_BUG_ON(check) ((void)sizeof(int[1-2*!!(check)]))
 
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(A) (sizeof(A)/sizeof(A[0]))
+#endif
+
 static struct addr_store ip_store;
 static struct addr_store mac_store;
+static struct batadv_genl_session batadv;
+static int cycle;
+
+/* chains which differ from the stores, initially they have to be flushed */
+static bool dat_dirty = true;
+static bool tl_dirty = true;
 
 char *addr_mac_ntoa(void *addr)
 {
@@ -35,104 +54,61 @@ char *addr_inet_ntoa(void *addr)
 	return inet_ntoa(*((struct in_addr *)addr));
 }
 
-static void ebt_ip_call(char *mod, struct in_addr ip)
+/* DATCHECK: -p ARP --arp-ip-dst <ip> -j mark --mark-or 0x2 --mark-target RETURN */
+static int ebt_ip_rule(void *addr, void *arg)
 {
-	char str[196];
-	int ret;
-
-	snprintf(str, sizeof(str),
-		 EBTABLES " %s ARP_LIMIT_DATCHECK -p ARP --arp-ip-dst %s -j mark --mark-or 0x2 --mark-target RETURN",
-		 mod, inet_ntoa(ip));
-
-	ret = system(str);
-	if (ret)
-		fprintf(stderr,
-			"%i: Calling ebtables for DAT failed with status %i\n",
-			clock, ret);
-}
-
-static void ip_node_destructor(struct addr_list *node)
-{
-	struct in_addr *ip = (struct in_addr *)node->addr;
-
-	ebt_ip_call("-D", *ip);
+	struct in_addr *ip = (struct in_addr *)addr;
+	struct gluonutil_ebt_rules *rules = arg;
+	struct ebt_entry entry = {
+		.ethproto = htons(ETH_P_ARP),
+	};
+	struct ebt_arp_info arp = {
+		.bitmask = EBT_ARP_DST_IP,
+		.daddr = ip->s_addr,
+		.dmsk = 0xffffffff,
+	};
+	struct ebt_mark_t_info mark = {
+		.mark = 0x2,
+		.target = MARK_OR_VALUE | (EBT_RETURN & EBT_VERDICT_BITS),
+	};
+
+	return gluonutil_ebt_rules_append(rules, &entry, EBT_ARP_MATCH, &arp,
+					  sizeof(arp), EBT_MARK_TARGET, &mark,
+					  sizeof(mark));
 }
 
-static void ebt_mac_limit_call(char *mod, struct mac_addr *mac)
+/*
+ * TLCHECK: --source <mac> --limit 6/min --limit-burst 50 -j RETURN
+ *          --source <mac> -j DROP
+ */
+static int ebt_mac_rules(void *addr, void *arg)
 {
-	char str[128];
+	struct mac_addr *mac = (struct mac_addr *)addr;
+	struct gluonutil_ebt_rules *rules = arg;
+	struct ebt_entry entry = {
+		.bitmask = EBT_NOPROTO | EBT_SOURCEMAC,
+	};
+	struct ebt_limit_info limit = {
+		.avg = EBT_LIMIT_SCALE * 60 / 6,
+		.burst = 50,
+	};
+	int verdict;
 	int ret;
 
-	snprintf(str, sizeof(str),
-		 EBTABLES " %s ARP_LIMIT_TLCHECK --source %s --limit 6/min --limit-burst 50 -j RETURN",
-		 mod, mac_ntoa(mac));
+	memcpy(entry.sourcemac, mac->storage, ETH_ALEN);
+	memset(entry.sourcemsk, 0xff, ETH_ALEN);
 
-	ret = system(str);
+	verdict = EBT_RETURN;
+	ret = gluonutil_ebt_rules_append(rules, &entry, EBT_LIMIT_MATCH, &limit,
+					 sizeof(limit), EBT_STANDARD_TARGET,
+					 &verdict, sizeof(verdict));
 	if (ret)
-		fprintf(stderr,
-			"%i: Calling ebtables for TL failed with status %i\n",
-			clock, ret);
-}
-
-static void ebt_mac_ret_call(char *mod, struct mac_addr *mac, int add)
-{
-	char str[128];
-	int ret;
+		return ret;
 
-	snprintf(str, sizeof(str),
-		 EBTABLES " %s ARP_LIMIT_TLCHECK %s --source %s -j DROP",
-		 mod, add ? "2" : "", mac_ntoa(mac));
-
-	ret = system(str);
-	if (ret)
-		fprintf(stderr,
-			"%i: Calling ebtables for TL failed with status %i\n",
-			clock, ret);
-}
-
-static void ebt_mac_call(char *mod, struct mac_addr *mac)
-{
-	if (!strncmp(mod, "-D", strlen(mod))) {
-		ebt_mac_ret_call(mod, mac, 0);
-		ebt_mac_limit_call(mod, mac);
-	} else {
-		ebt_mac_limit_call(mod, mac);
-		ebt_mac_ret_call(mod, mac, 1);
-	}
-}
-
-static void mac_node_destructor(struct addr_list *node)
-{
-	struct mac_addr *mac = (struct mac_addr *)node->addr;
-
-	ebt_mac_call("-D", mac);
-}
-
-static int dat_parse_line(const char *line, struct in_addr *ip)
-{
-	int ret;
-	char *p;
-	char *tok;
-
-	p = strpbrk(line, "0123456789");
-	if (!p) {
-		fprintf(stderr, "Error: Can't find integer in: %s\n", line);
-		return -EINVAL;
-	}
-
-	tok = strtok(p, " ");
-	if (!tok) {
-		fprintf(stderr, "Error: Can't find end of string': %s\n", line);
-		return -EINVAL;
-	}
-
-	ret = inet_aton(p, ip);
-	if (!ret) {
-		fprintf(stderr, "Error: inet_aton failed on: %s\n", p);
-		return -EINVAL;
-	}
-
-	return 0;
+	verdict = EBT_DROP;
+	return gluonutil_ebt_rules_append(rules, &entry, NULL, NULL, 0,
+					  EBT_STANDARD_TARGET, &verdict,
+					  sizeof(verdict));
 }
 
 static void ebt_add_ip(struct in_addr ip)
@@ -143,7 +119,7 @@ static void ebt_add_ip(struct in_addr ip)
 	if (ret)
 		return;
 
-	ebt_ip_call("-I", ip);
+	dat_dirty = true;
 }
 
 static void ebt_add_mac(struct mac_addr *mac)
@@ -154,148 +130,196 @@ static void ebt_add_mac(struct mac_addr *mac)
 	if (ret)
 		return;
 
-	ebt_mac_call("-I", mac);
+	tl_dirty = true;
 }
 
-static void ebt_dat_update(void)
+enum {
+	DAT_ATTR_IP4ADDRESS,
+	DAT_ATTR_NUM,
+};
+
+static int parse_dat_cache(struct nl_msg *msg,
+			   void *arg __attribute__((unused)))
 {
-	FILE *fp;
-	char line[256];
-	char *pline;
-	int ret;
+	static const struct batadv_genl_attr_spec spec[DAT_ATTR_NUM] = {
+		[DAT_ATTR_IP4ADDRESS] = { BATADV_ATTR_DAT_CACHE_IP4ADDRESS, true },
+	};
+	struct nlattr *attrs[DAT_ATTR_NUM];
 	struct in_addr ip;
 
-	fp = popen(BATCTL_DC, "r");
-	if (!fp) {
-		fprintf(stderr, "%i: Error: Could not call batctl dc\n", clock);
-		return;
-	}
-	
-	while (1) {
-		pline = fgets(line, sizeof(line), fp);
-		if (!pline) {
-			if (!feof(fp))
-				fprintf(stderr, "%i: Error: fgets() failed\n", clock);
-			break;
-		}
+	if (batadv_genl_parse(msg, BATADV_CMD_GET_DAT_CACHE, spec, attrs,
+			      DAT_ATTR_NUM))
+		return NL_OK;
 
-		ret = dat_parse_line(line, &ip);
-		if (ret < 0) {
-			fprintf(stderr, "%i: Error: Parsing line failed\n",
-				clock);
-			break;
-		}
-
-		ebt_add_ip(ip);
-	}
+	/* already in network byte order */
+	ip.s_addr = nla_get_u32(attrs[DAT_ATTR_IP4ADDRESS]);
+	ebt_add_ip(ip);
 
-	pclose(fp);
+	return NL_OK;
 }
 
-static int tl_parse_line(char *line, struct mac_addr *mac)
+enum {
+	TT_LOCAL_ATTR_ADDRESS,
+	TT_LOCAL_ATTR_NUM,
+};
+
+static int parse_tt_local(struct nl_msg *msg,
+			  void *arg __attribute__((unused)))
 {
-	int ret;
-	char *p;
-	char *tok;
+	static const struct batadv_genl_attr_spec spec[TT_LOCAL_ATTR_NUM] = {
+		[TT_LOCAL_ATTR_ADDRESS] = { BATADV_ATTR_TT_ADDRESS, true },
+	};
+	struct nlattr *attrs[TT_LOCAL_ATTR_NUM];
+	struct mac_addr mac = {};
 
-	p = strpbrk(line, "0123456789abcdef");
-	if (!p) {
-		fprintf(stderr, "Error: Can't find hex in: %s\n", line);
-		return -EINVAL;
-	}
+	if (batadv_genl_parse(msg, BATADV_CMD_GET_TRANSTABLE_LOCAL, spec,
+			      attrs, TT_LOCAL_ATTR_NUM))
+		return NL_OK;
 
-	tok = strtok(p, " ");
-	if (!tok) {
-		fprintf(stderr, "Error: Can't find end of string': %s\n", line);
-		return -EINVAL;
-	}
+	memcpy(mac.storage, nla_data(attrs[TT_LOCAL_ATTR_ADDRESS]), ETH_ALEN);
+	if (mac_is_multicast(&mac))
+		return NL_OK;
 
-	ret = mac_aton(p, mac);
-	if (!ret) {
-		fprintf(stderr, "Error: mac_aton failed on: %s\n", p);
-		return -EINVAL;
-	}
+	ebt_add_mac(&mac);
 
-	return 0;
+	return NL_OK;
 }
 
-static void ebt_tl_update(void)
+/*
+ * Dumps the DAT cache and the local translation table into the stores.
+ * Entries which have disappeared since the last update are removed by the
+ * following addr_store_cleanup() of the respective store; ebt_commit()
+ * then writes the changed chains.
+ *
+ * A store must not be cleaned up when its dump failed, as this would remove
+ * all of its rules.
+ */
+static void ebt_update(bool *dat_valid, bool *tl_valid)
 {
-	FILE *fp;
-	char line[256];
-	char *pline;
-	int ret;
-	struct mac_addr mac;
-
-	fp = popen(BATCTL_TL, "r");
-	if (!fp) {
-		fprintf(stderr, "%i: Error: Could not call batctl tl\n", clock);
-		return;
-	}
-
-	while (1) {
-		pline = fgets(line, sizeof(line), fp);
-		if (!pline) {
-			if (!feof(fp))
-				fprintf(stderr, "%i: Error: fgets() failed\n", clock);
-			break;
-		}
+	struct batadv_nlquery_opts dat_opts = {};
+	struct batadv_nlquery_opts tl_opts = {};
+	const struct batadv_genl_dump dumps[] = {
+		{
+			.cmd = BATADV_CMD_GET_DAT_CACHE,
+			.callback = parse_dat_cache,
+			.query_opts = &dat_opts,
+		},
+		{
+			.cmd = BATADV_CMD_GET_TRANSTABLE_LOCAL,
+			.callback = parse_tt_local,
+			.query_opts = &tl_opts,
+		},
+	};
+
+	/* errors are reported per dump in the query options */
+	batadv_genl_session_dump(&batadv, dumps, ARRAY_SIZE(dumps));
+
+	if (dat_opts.err < 0)
+		fprintf(stderr, "%i: Error: Dumping the DAT cache failed: %s\n",
+			cycle, strerror(-dat_opts.err));
+	if (tl_opts.err < 0)
+		fprintf(stderr, "%i: Error: Dumping the local translation table failed: %s\n",
+			cycle, strerror(-tl_opts.err));
+
+	*dat_valid = !dat_opts.err;
+	*tl_valid = !tl_opts.err;
+}
 
-		ret = tl_parse_line(line, &mac);
-		if (ret < 0) {
-			fprintf(stderr, "%i: Error: Parsing line failed\n",
-				clock);
-			break;
-		}
+/*
+ * Writes the rules for all stored addresses to the chains which have
+ * changed in this update cycle, in a single atomic table update.
+ */
+static void ebt_commit(void)
+{
+	const char *chains[2];
+	struct gluonutil_ebt_rules rules[2];
+	size_t num = 0;
+	int ret = 0;
 
-		if (mac_is_multicast(&mac))
-			continue;
+	if (!dat_dirty && !tl_dirty)
+		return;
 
-		ebt_add_mac(&mac);
+	/* unchanged chains keep their rules */
+	if (dat_dirty) {
+		chains[num] = "ARP_LIMIT_DATCHECK";
+		gluonutil_ebt_rules_init(&rules[num]);
+		ret = addr_store_foreach(&ip_store, ebt_ip_rule, &rules[num]);
+		num++;
 	}
 
-	pclose(fp);
-}
-
-static void ebt_dat_flush(void)
-{
-	int ret = system(EBTABLES " -F ARP_LIMIT_DATCHECK");
+	if (tl_dirty && !ret) {
+		chains[num] = "ARP_LIMIT_TLCHECK";
+		gluonutil_ebt_rules_init(&rules[num]);
+		ret = addr_store_foreach(&mac_store, ebt_mac_rules, &rules[num]);
+		num++;
+	}
 
-	if (ret)
-		fprintf(stderr, "Error flushing ARP_LIMIT_DATCHECK\n");
-}
+	if (!ret)
+		ret = gluonutil_ebt_replace_chains("filter", chains, rules, num);
 
-static void ebt_tl_flush(void)
-{
-	int ret = system(EBTABLES " -F ARP_LIMIT_TLCHECK");
+	if (ret) {
+		/* retried in the next cycle */
+		fprintf(stderr, "%i: Error: Updating ebtables failed: %s\n",
+			cycle, strerror(-ret));
+	} else {
+		dat_dirty = false;
+		tl_dirty = false;
+	}
 
-	if (ret)
-		fprintf(stderr, "Error flushing ARP_LIMIT_TLCHECK\n");
+	while (num--)
+		gluonutil_ebt_rules_free(&rules[num]);
 }
 
 int main(int argc, char *argv[])
 {
-	ebt_dat_flush();
-	ebt_tl_flush();
+	bool dump = false;
+	int c;
+
+	while ((c = getopt(argc, argv, "d")) != -1) {
+		switch (c) {
+		case 'd':
+			dump = true;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-d]\n", argv[0]);
+			return 1;
+		}
+	}
 
 	/* necessary alignment for hashword() */
 	BUILD_BUG_ON(sizeof(struct in_addr) % sizeof(uint32_t) != 0);
 	BUILD_BUG_ON(sizeof(struct mac_addr) % sizeof(uint32_t) != 0);
 
-	addr_store_init(sizeof(struct in_addr), &ip_node_destructor,
-			addr_inet_ntoa, &ip_store);
-	addr_store_init(sizeof(struct mac_addr), &mac_node_destructor,
-			addr_mac_ntoa, &mac_store);
+	if (addr_store_init(sizeof(struct in_addr), addr_inet_ntoa,
+			    &ip_store) ||
+	    addr_store_init(sizeof(struct mac_addr), addr_mac_ntoa,
+			    &mac_store))
+		return 1;
+
+	if (batadv_genl_session_open(&batadv, MESH_IFACE) < 0) {
+		fprintf(stderr, "Error: Can't open netlink session for " MESH_IFACE "\n");
+		return 1;
+	}
 
 	while (1) {
-		ebt_dat_update();
-		addr_store_cleanup(&ip_store);
+		bool dat_valid, tl_valid;
+
+		ebt_update(&dat_valid, &tl_valid);
 
-		ebt_tl_update();
-		addr_store_cleanup(&mac_store);
+		if (dat_valid && addr_store_cleanup(&ip_store))
+			dat_dirty = true;
+		if (tl_valid && addr_store_cleanup(&mac_store))
+			tl_dirty = true;
+
+		ebt_commit();
+
+		if (dump) {
+			addr_store_dump(&ip_store);
+			addr_store_dump(&mac_store);
+		}
 
 		sleep(30);
-		clock++;
+		cycle++;
 	}
 
 	return 0;
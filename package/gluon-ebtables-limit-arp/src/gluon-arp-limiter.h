@@ -1,13 +0,0 @@
-/*
- * Copyright (c) 2017 Linus Lüssing <linus.luessing@c0d3.blue>
- *
- * SPDX-License-Identifier: GPL-2.0+
- * License-Filename: LICENSE
- */
-
-#ifndef _GLUON_ARP_LIMITER_H_
-#define _GLUON_ARP_LIMITER_H_
-
-int clock;
-
-#endif /* _GLUON_ARP_LIMITER_H_ */
@@ -99,31 +99,6 @@ static bool get_linklocal_address(const char *ifname, char lladdr[INET6_ADDRSTRL
 }
 
 
-static char*  get_line_from_run(const char* command) {
-	FILE *fp;
-	char *line = NULL;
-	size_t len = 0;
-
-	fp = popen(command, "r");
-
-	if (fp != NULL) {
-		ssize_t r = getline(&line, &len, fp);
-		if (r >= 0) {
-			len = strlen(line);
-
-			if (len && line[len-1] == '\n')
-				line[len-1] = 0;
-		}
-		else {
-			free(line);
-			line = NULL;
-		}
-
-		pclose(fp);
-	}
-	return line;
-}
-
 static struct json_object * get_addresses(void) {
 	char *primarymac = gluonutil_get_sysconfig("primary_mac");
 	char *address = malloc(INET6_ADDRSTRLEN+1);
@@ -358,14 +333,31 @@ static struct json_object * get_mesh(void) {
 	return ret;
 }
 
+/* Recorded by the upgrade scripts, see 320-gluon-mesh-babel-version */
 static struct json_object * get_babeld_version(void) {
-	char *version = get_line_from_run("exec babeld -V 2>&1");
-	struct json_object *ret = gluonutil_wrap_string(version);
-	free(version);
-	return ret;
+	return gluonutil_wrap_and_free_string(gluonutil_get_sysconfig("babeld_version"));
+}
+
+static struct json_object * get_software(void) {
+	struct json_object *software = json_object_new_object();
+	struct json_object *software_babeld = json_object_new_object();
+	json_object_object_add(software_babeld, "version", get_babeld_version());
+	json_object_object_add(software, "babeld", software_babeld);
+
+	return software;
 }
 
 static struct json_object * respondd_provider_nodeinfo(void) {
+	/* Interfaces and addresses change at runtime, only the software part is cached */
+	static const char *const software_files[] = {
+		"/lib/gluon/core/sysconfig/babeld_version",
+		NULL,
+	};
+	static struct gluonutil_json_cache software_cache = {
+		.ttl = 0,
+		.files = software_files,
+	};
+
 	bhelper_ctx.debug=false;
 	struct json_object *ret = json_object_new_object();
 
@@ -374,11 +366,7 @@ static struct json_object * respondd_provider_nodeinfo(void) {
 	json_object_object_add(network, "mesh", get_mesh());
 	json_object_object_add(ret, "network", network);
 
-	struct json_object *software = json_object_new_object();
-	struct json_object *software_babeld = json_object_new_object();
-	json_object_object_add(software_babeld, "version", get_babeld_version());
-	json_object_object_add(software, "babeld", software_babeld);
-	json_object_object_add(ret, "software", software);
+	json_object_object_add(ret, "software", gluonutil_json_cache_get(&software_cache, get_software));
 
 	return ret;
 }
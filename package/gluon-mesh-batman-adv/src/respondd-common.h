@@ -25,6 +25,10 @@
 
 #pragma once
 
+struct batadv_genl_session;
+
+struct batadv_genl_session * respondd_batadv_session(void);
+
 struct json_object * respondd_provider_nodeinfo(void);
 struct json_object * respondd_provider_statistics(void);
 struct json_object * respondd_provider_neighbours(void);
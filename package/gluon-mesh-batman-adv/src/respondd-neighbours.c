@@ -66,20 +66,29 @@ static struct json_object * ifnames2addrs(struct json_object *interfaces) {
 	return ret;
 }
 
-static const enum batadv_nl_attrs parse_orig_list_mandatory[] = {
-	BATADV_ATTR_ORIG_ADDRESS,
-	BATADV_ATTR_NEIGH_ADDRESS,
-	BATADV_ATTR_TQ,
-	BATADV_ATTR_HARD_IFINDEX,
-	BATADV_ATTR_LAST_SEEN_MSECS,
+enum {
+	ORIG_LIST_ATTR_ORIG_ADDRESS,
+	ORIG_LIST_ATTR_NEIGH_ADDRESS,
+	ORIG_LIST_ATTR_TQ,
+	ORIG_LIST_ATTR_HARD_IFINDEX,
+	ORIG_LIST_ATTR_LAST_SEEN_MSECS,
+	ORIG_LIST_ATTR_FLAG_BEST,
+	ORIG_LIST_ATTR_NUM,
+};
+
+static const struct batadv_genl_attr_spec parse_orig_list_attrs[ORIG_LIST_ATTR_NUM] = {
+	[ORIG_LIST_ATTR_ORIG_ADDRESS] = { BATADV_ATTR_ORIG_ADDRESS, true },
+	[ORIG_LIST_ATTR_NEIGH_ADDRESS] = { BATADV_ATTR_NEIGH_ADDRESS, true },
+	[ORIG_LIST_ATTR_TQ] = { BATADV_ATTR_TQ, true },
+	[ORIG_LIST_ATTR_HARD_IFINDEX] = { BATADV_ATTR_HARD_IFINDEX, true },
+	[ORIG_LIST_ATTR_LAST_SEEN_MSECS] = { BATADV_ATTR_LAST_SEEN_MSECS, true },
+	[ORIG_LIST_ATTR_FLAG_BEST] = { BATADV_ATTR_FLAG_BEST, false },
 };
 
 static int parse_orig_list_netlink_cb(struct nl_msg *msg, void *arg)
 {
-	struct nlattr *attrs[BATADV_ATTR_MAX+1];
-	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct nlattr *attrs[ORIG_LIST_ATTR_NUM];
 	struct batadv_nlquery_opts *query_opts = arg;
-	struct genlmsghdr *ghdr;
 	uint8_t *orig;
 	uint8_t *dest;
 	uint8_t tq;
@@ -92,27 +101,15 @@ static int parse_orig_list_netlink_cb(struct nl_msg *msg, void *arg)
 	opts = batadv_container_of(query_opts, struct neigh_netlink_opts,
 				   query_opts);
 
-	if (!genlmsg_valid_hdr(nlh, 0))
-		return NL_OK;
-
-	ghdr = nlmsg_data(nlh);
-
-	if (ghdr->cmd != BATADV_CMD_GET_ORIGINATORS)
-		return NL_OK;
-
-	if (nla_parse(attrs, BATADV_ATTR_MAX, genlmsg_attrdata(ghdr, 0),
-		      genlmsg_len(ghdr), batadv_genl_policy))
-		return NL_OK;
-
-	if (batadv_genl_missing_attrs(attrs, parse_orig_list_mandatory,
-				      BATADV_ARRAY_SIZE(parse_orig_list_mandatory)))
+	if (batadv_genl_parse(msg, BATADV_CMD_GET_ORIGINATORS,
+			      parse_orig_list_attrs, attrs, ORIG_LIST_ATTR_NUM))
 		return NL_OK;
 
-	orig = nla_data(attrs[BATADV_ATTR_ORIG_ADDRESS]);
-	dest = nla_data(attrs[BATADV_ATTR_NEIGH_ADDRESS]);
-	tq = nla_get_u8(attrs[BATADV_ATTR_TQ]);
-	hardif = nla_get_u32(attrs[BATADV_ATTR_HARD_IFINDEX]);
-	lastseen = nla_get_u32(attrs[BATADV_ATTR_LAST_SEEN_MSECS]);
+	orig = nla_data(attrs[ORIG_LIST_ATTR_ORIG_ADDRESS]);
+	dest = nla_data(attrs[ORIG_LIST_ATTR_NEIGH_ADDRESS]);
+	tq = nla_get_u8(attrs[ORIG_LIST_ATTR_TQ]);
+	hardif = nla_get_u32(attrs[ORIG_LIST_ATTR_HARD_IFINDEX]);
+	lastseen = nla_get_u32(attrs[ORIG_LIST_ATTR_LAST_SEEN_MSECS]);
 
 	if (memcmp(orig, dest, 6) != 0)
 		return NL_OK;
@@ -136,7 +133,7 @@ static int parse_orig_list_netlink_cb(struct nl_msg *msg, void *arg)
 
 	json_object_object_add(obj, "tq", json_object_new_int(tq));
 	json_object_object_add(obj, "lastseen", json_object_new_double(lastseen / 1000.));
-	json_object_object_add(obj, "best", json_object_new_boolean(!!attrs[BATADV_ATTR_FLAG_BEST]));
+	json_object_object_add(obj, "best", json_object_new_boolean(!!attrs[ORIG_LIST_ATTR_FLAG_BEST]));
 	json_object_object_add(interface, mac1, obj);
 
 	return NL_OK;
@@ -154,9 +151,10 @@ static struct json_object * get_batadv(void) {
 	if (!opts.interfaces)
 		return NULL;
 
-	ret = batadv_genl_query("bat0", BATADV_CMD_GET_ORIGINATORS,
-				parse_orig_list_netlink_cb, NLM_F_DUMP,
-				&opts.query_opts);
+	ret = batadv_genl_session_query(respondd_batadv_session(),
+					BATADV_CMD_GET_ORIGINATORS,
+					parse_orig_list_netlink_cb, NLM_F_DUMP,
+					&opts.query_opts);
 	if (ret < 0) {
 		json_object_put(opts.interfaces);
 		return NULL;
@@ -187,7 +187,23 @@ static struct json_object * get_mesh(void) {
 	return ret;
 }
 
+static struct json_object * get_software(void) {
+	struct json_object *software = json_object_new_object();
+	struct json_object *software_batman_adv = json_object_new_object();
+	json_object_object_add(software_batman_adv, "version",
+		gluonutil_wrap_and_free_string(gluonutil_read_line("/sys/module/batman_adv/version")));
+	json_object_object_add(software_batman_adv, "compat", json_object_new_int(15));
+	json_object_object_add(software, "batman-adv", software_batman_adv);
+
+	return software;
+}
+
 struct json_object * respondd_provider_nodeinfo(void) {
+	/* Interfaces and addresses change at runtime, only the software part is cached */
+	static struct gluonutil_json_cache software_cache = {
+		.ttl = GLUONUTIL_JSON_CACHE_TTL,
+	};
+
 	struct json_object *ret = json_object_new_object();
 
 	struct json_object *network = json_object_new_object();
@@ -195,13 +211,7 @@ struct json_object * respondd_provider_nodeinfo(void) {
 	json_object_object_add(network, "mesh", get_mesh());
 	json_object_object_add(ret, "network", network);
 
-	struct json_object *software = json_object_new_object();
-	struct json_object *software_batman_adv = json_object_new_object();
-	json_object_object_add(software_batman_adv, "version",
-		gluonutil_wrap_and_free_string(gluonutil_read_line("/sys/module/batman_adv/version")));
-	json_object_object_add(software_batman_adv, "compat", json_object_new_int(15));
-	json_object_object_add(software, "batman-adv", software_batman_adv);
-	json_object_object_add(ret, "software", software);
+	json_object_object_add(ret, "software", gluonutil_json_cache_get(&software_cache, get_software));
 
 	return ret;
 }
@@ -56,21 +56,28 @@ struct clients_netlink_opts {
 
 struct gw_netlink_opts {
 	struct json_object *obj;
+	bool found;
 	struct batadv_nlquery_opts query_opts;
 };
 
 
-static const enum batadv_nl_attrs gateways_mandatory[] = {
-	BATADV_ATTR_ORIG_ADDRESS,
-	BATADV_ATTR_ROUTER,
+enum {
+	GW_ATTR_ORIG_ADDRESS,
+	GW_ATTR_ROUTER,
+	GW_ATTR_FLAG_BEST,
+	GW_ATTR_NUM,
+};
+
+static const struct batadv_genl_attr_spec gateways_attrs[GW_ATTR_NUM] = {
+	[GW_ATTR_ORIG_ADDRESS] = { BATADV_ATTR_ORIG_ADDRESS, true },
+	[GW_ATTR_ROUTER] = { BATADV_ATTR_ROUTER, true },
+	[GW_ATTR_FLAG_BEST] = { BATADV_ATTR_FLAG_BEST, true },
 };
 
 static int parse_gw_list_netlink_cb(struct nl_msg *msg, void *arg)
 {
-	struct nlattr *attrs[BATADV_ATTR_MAX+1];
-	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct nlattr *attrs[GW_ATTR_NUM];
 	struct batadv_nlquery_opts *query_opts = arg;
-	struct genlmsghdr *ghdr;
 	uint8_t *orig;
 	uint8_t *router;
 	struct gw_netlink_opts *opts;
@@ -79,27 +86,18 @@ static int parse_gw_list_netlink_cb(struct nl_msg *msg, void *arg)
 	opts = batadv_container_of(query_opts, struct gw_netlink_opts,
 				   query_opts);
 
-	if (!genlmsg_valid_hdr(nlh, 0))
-		return NL_OK;
-
-	ghdr = nlmsg_data(nlh);
-
-	if (ghdr->cmd != BATADV_CMD_GET_GATEWAYS)
-		return NL_OK;
-
-	if (nla_parse(attrs, BATADV_ATTR_MAX, genlmsg_attrdata(ghdr, 0),
-		      genlmsg_len(ghdr), batadv_genl_policy))
-		return NL_OK;
-
-	if (batadv_genl_missing_attrs(attrs, gateways_mandatory,
-				      BATADV_ARRAY_SIZE(gateways_mandatory)))
+	/* Keep consuming the dump instead of stopping it, so the session
+	 * socket can be reused */
+	if (opts->found)
 		return NL_OK;
 
-	if (!attrs[BATADV_ATTR_FLAG_BEST])
+	/* Only the best gateway is interesting */
+	if (batadv_genl_parse(msg, BATADV_CMD_GET_GATEWAYS, gateways_attrs,
+			      attrs, GW_ATTR_NUM))
 		return NL_OK;
 
-	orig = nla_data(attrs[BATADV_ATTR_ORIG_ADDRESS]);
-	router = nla_data(attrs[BATADV_ATTR_ROUTER]);
+	orig = nla_data(attrs[GW_ATTR_ORIG_ADDRESS]);
+	router = nla_data(attrs[GW_ATTR_ROUTER]);
 
 	sprintf(addr, "%02x:%02x:%02x:%02x:%02x:%02x",
 		orig[0], orig[1], orig[2], orig[3], orig[4], orig[5]);
@@ -111,20 +109,9 @@ static int parse_gw_list_netlink_cb(struct nl_msg *msg, void *arg)
 
 	json_object_object_add(opts->obj, "gateway_nexthop", json_object_new_string(addr));
 
-	return NL_STOP;
-}
-
-static void add_gateway(struct json_object *obj) {
-	struct gw_netlink_opts opts = {
-		.obj = obj,
-		.query_opts = {
-			.err = 0,
-		},
-	};
+	opts->found = true;
 
-	batadv_genl_query("bat0", BATADV_CMD_GET_GATEWAYS,
-			  parse_gw_list_netlink_cb, NLM_F_DUMP,
-			  &opts.query_opts);
+	return NL_OK;
 }
 
 static inline bool ethtool_ioctl(int fd, struct ifreq *ifr, void *data) {
@@ -239,50 +226,42 @@ static struct json_object * get_traffic(void) {
 	return ret;
 }
 
-static const enum batadv_nl_attrs clients_mandatory[] = {
-	BATADV_ATTR_TT_FLAGS,
+enum {
+	CLIENTS_ATTR_TT_FLAGS,
+	CLIENTS_ATTR_LAST_SEEN_MSECS,
+	CLIENTS_ATTR_NUM,
+};
+
+static const struct batadv_genl_attr_spec clients_attrs[CLIENTS_ATTR_NUM] = {
+	[CLIENTS_ATTR_TT_FLAGS] = { BATADV_ATTR_TT_FLAGS, true },
 	/* Entries without the BATADV_TT_CLIENT_NOPURGE flag do not have a
 	 * BATADV_ATTR_LAST_SEEN_MSECS attribute. We can still make this attr
 	 * mandatory here, as entries without BATADV_TT_CLIENT_NOPURGE are
 	 * ignored anyways.
 	 */
-	BATADV_ATTR_LAST_SEEN_MSECS,
+	[CLIENTS_ATTR_LAST_SEEN_MSECS] = { BATADV_ATTR_LAST_SEEN_MSECS, true },
 };
 
 static int parse_clients_list_netlink_cb(struct nl_msg *msg, void *arg)
 {
-	struct nlattr *attrs[BATADV_ATTR_MAX+1];
-	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct nlattr *attrs[CLIENTS_ATTR_NUM];
 	struct batadv_nlquery_opts *query_opts = arg;
-	struct genlmsghdr *ghdr;
 	struct clients_netlink_opts *opts;
 	uint32_t flags, lastseen;
 
 	opts = batadv_container_of(query_opts, struct clients_netlink_opts,
 				   query_opts);
 
-	if (!genlmsg_valid_hdr(nlh, 0))
+	if (batadv_genl_parse(msg, BATADV_CMD_GET_TRANSTABLE_LOCAL,
+			      clients_attrs, attrs, CLIENTS_ATTR_NUM))
 		return NL_OK;
 
-	ghdr = nlmsg_data(nlh);
-
-	if (ghdr->cmd != BATADV_CMD_GET_TRANSTABLE_LOCAL)
-		return NL_OK;
-
-	if (nla_parse(attrs, BATADV_ATTR_MAX, genlmsg_attrdata(ghdr, 0),
-		      genlmsg_len(ghdr), batadv_genl_policy))
-		return NL_OK;
-
-	if (batadv_genl_missing_attrs(attrs, clients_mandatory,
-				      BATADV_ARRAY_SIZE(clients_mandatory)))
-		return NL_OK;
-
-	flags = nla_get_u32(attrs[BATADV_ATTR_TT_FLAGS]);
+	flags = nla_get_u32(attrs[CLIENTS_ATTR_TT_FLAGS]);
 
 	if (flags & (BATADV_TT_CLIENT_NOPURGE))
 		return NL_OK;
 
-	lastseen = nla_get_u32(attrs[BATADV_ATTR_LAST_SEEN_MSECS]);
+	lastseen = nla_get_u32(attrs[CLIENTS_ATTR_LAST_SEEN_MSECS]);
 	if (lastseen > MAX_INACTIVITY)
 		return NL_OK;
 
@@ -291,21 +270,10 @@ static int parse_clients_list_netlink_cb(struct nl_msg *msg, void *arg)
 	return NL_OK;
 }
 
-static struct json_object * get_clients(void) {
-	struct clients_netlink_opts opts = {
-		.clients = 0,
-		.query_opts = {
-			.err = 0,
-		},
-	};
-
-	batadv_genl_query("bat0", BATADV_CMD_GET_TRANSTABLE_LOCAL,
-			  parse_clients_list_netlink_cb, NLM_F_DUMP,
-			  &opts.query_opts);
-
+static struct json_object * get_clients(size_t clients) {
 	struct json_object *ret = json_object_new_object();
 
-	json_object_object_add(ret, "total", json_object_new_int(opts.clients));
+	json_object_object_add(ret, "total", json_object_new_int(clients));
 
 	return ret;
 }
@@ -313,10 +281,38 @@ static struct json_object * get_clients(void) {
 struct json_object * respondd_provider_statistics(void) {
 	struct json_object *ret = json_object_new_object();
 
-	json_object_object_add(ret, "clients", get_clients());
-	json_object_object_add(ret, "traffic", get_traffic());
+	struct clients_netlink_opts clients_opts = {
+		.clients = 0,
+		.query_opts = {
+			.err = 0,
+		},
+	};
+	struct gw_netlink_opts gw_opts = {
+		.obj = ret,
+		.found = false,
+		.query_opts = {
+			.err = 0,
+		},
+	};
+	const struct batadv_genl_dump dumps[] = {
+		{
+			.cmd = BATADV_CMD_GET_TRANSTABLE_LOCAL,
+			.callback = parse_clients_list_netlink_cb,
+			.query_opts = &clients_opts.query_opts,
+		},
+		{
+			.cmd = BATADV_CMD_GET_GATEWAYS,
+			.callback = parse_gw_list_netlink_cb,
+			.query_opts = &gw_opts.query_opts,
+		},
+	};
 
-	add_gateway(ret);
+	/* Both tables are dumped back to back over the same socket */
+	batadv_genl_session_dump(respondd_batadv_session(), dumps,
+				 BATADV_ARRAY_SIZE(dumps));
+
+	json_object_object_add(ret, "clients", get_clients(clients_opts.clients));
+	json_object_object_add(ret, "traffic", get_traffic());
 
 	return ret;
 }
@@ -25,8 +25,23 @@
 
 #include "respondd-common.h"
 
+#include <batadv-genl.h>
 #include <respondd.h>
 
+#include <stdbool.h>
+
+
+struct batadv_genl_session * respondd_batadv_session(void) {
+	static struct batadv_genl_session session;
+	static bool initialized = false;
+
+	if (!initialized) {
+		batadv_genl_session_open(&session, "bat0");
+		initialized = true;
+	}
+
+	return &session;
+}
 
 __attribute__ ((visibility ("default")))
 const struct respondd_provider_info respondd_providers[] = {
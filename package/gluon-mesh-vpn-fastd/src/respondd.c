@@ -28,6 +28,7 @@
 
 #include <json-c/json.h>
 #include <libgluonutil.h>
+#include <libuecc/ecc.h>
 #include <uci.h>
 
 #include <stdbool.h>
@@ -41,62 +42,61 @@
 
 static struct json_object * get_peer_groups(struct json_object *groups, struct json_object *peers);
 
+/* Recorded by the upgrade scripts, see 420-mesh-vpn-fastd-respondd */
 static struct json_object * get_fastd_version(void) {
-	FILE *f = popen("exec fastd -v", "r");
-	if (!f)
-		return NULL;
+	return gluonutil_wrap_and_free_string(gluonutil_get_sysconfig("fastd_version"));
+}
 
-	char *line = NULL;
-	size_t len = 0;
+static int hex_value(char c) {
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	else if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	else if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	else
+		return -1;
+}
 
-	ssize_t r = getline(&line, &len, f);
+static bool parse_key(ecc_int256_t *key, const char *str) {
+	size_t i;
 
-	pclose(f);
+	if (strlen(str) != 2 * sizeof(key->p))
+		return false;
 
-	if (r >= 0) {
-		len = strlen(line); /* The len given by getline is the buffer size, not the string length */
+	for (i = 0; i < sizeof(key->p); i++) {
+		int hi = hex_value(str[2*i]), lo = hex_value(str[2*i+1]);
+		if (hi < 0 || lo < 0)
+			return false;
 
-		if (len && line[len-1] == '\n')
-			line[len-1] = 0;
-	}
-	else {
-		free(line);
-		line = NULL;
+		key->p[i] = (hi << 4) | lo;
 	}
 
-	const char *version = line;
-	if (strncmp(version, "fastd ", 6) == 0)
-		version += 6;
-
-	struct json_object *ret = gluonutil_wrap_string(version);
-	free(line);
-	return ret;
+	return true;
 }
 
-static struct json_object * get_fastd_public_key(void) {
-	FILE *f = popen("/etc/init.d/fastd show_key mesh_vpn", "r");
-	if (!f)
+/*
+ * Derives the public key from the configured secret the same way as
+ * "fastd --show-key", so changes of the secret are picked up with the next
+ * rebuild of the cached nodeinfo
+ */
+static struct json_object * get_fastd_public_key(const char *secret) {
+	ecc_int256_t secret_key, public_key;
+	ecc_25519_work_t work;
+	char buf[2 * sizeof(public_key.p) + 1];
+	size_t i;
+
+	/* "generate" is replaced by a new secret on the first start of fastd */
+	if (!secret || !parse_key(&secret_key, secret))
 		return NULL;
 
-	char *line = NULL;
-	size_t len = 0;
-
-	ssize_t r = getline(&line, &len, f);
-
-	pclose(f);
+	ecc_25519_scalarmult_base(&work, &secret_key);
+	ecc_25519_store_packed_legacy(&public_key, &work);
 
-	if (r >= 0) {
-		len = strlen(line); /* The len given by getline is the buffer size, not the string length */
+	for (i = 0; i < sizeof(public_key.p); i++)
+		snprintf(&buf[2*i], 3, "%02x", public_key.p[i]);
 
-		if (len && line[len-1] == '\n')
-			line[len-1] = 0;
-	}
-	else {
-		free(line);
-		line = NULL;
-	}
-
-	return gluonutil_wrap_and_free_string(line);
+	return json_object_new_string(buf);
 }
 
 static bool get_pubkey_privacy(void) {
@@ -125,6 +125,7 @@ end:
 
 static struct json_object * get_fastd(void) {
 	bool enabled = false;
+	struct json_object *public_key = NULL;
 	struct json_object *ret = json_object_new_object();
 
 	struct uci_context *ctx = uci_alloc_context();
@@ -144,18 +145,21 @@ static struct json_object * get_fastd(void) {
 	if (!enabled_str || !strcmp(enabled_str, "1"))
 		enabled = true;
 
+	if (enabled && !get_pubkey_privacy())
+		public_key = get_fastd_public_key(uci_lookup_option_string(ctx, s, "secret"));
+
 disabled:
 	uci_free_context(ctx);
 
 disabled_nofree:
 	json_object_object_add(ret, "version", get_fastd_version());
 	json_object_object_add(ret, "enabled", json_object_new_boolean(enabled));
-	if (enabled && !get_pubkey_privacy())
-		json_object_object_add(ret, "public_key", get_fastd_public_key());
+	if (public_key)
+		json_object_object_add(ret, "public_key", public_key);
 	return ret;
 }
 
-static struct json_object * respondd_provider_nodeinfo(void) {
+static struct json_object * get_nodeinfo(void) {
 	struct json_object *ret = json_object_new_object();
 
 	struct json_object *software = json_object_new_object();
@@ -165,6 +169,23 @@ static struct json_object * respondd_provider_nodeinfo(void) {
 	return ret;
 }
 
+static struct json_object * respondd_provider_nodeinfo(void) {
+	static const char *const files[] = {
+		"/etc/config/fastd",
+		"/lib/gluon/core/sysconfig/fastd_version",
+		"/lib/gluon/site.json",
+		/* pubkey_privacy may be overridden by the domain selected here */
+		"/etc/config/gluon",
+		NULL,
+	};
+	static struct gluonutil_json_cache cache = {
+		.ttl = GLUONUTIL_JSON_CACHE_TTL,
+		.files = files,
+	};
+
+	return gluonutil_json_cache_get(&cache, get_nodeinfo);
+}
+
 
 static const char * get_status_socket(struct uci_context *ctx, struct uci_section *s) {
 	return uci_lookup_option_string(ctx, s, "status_socket");
@@ -23,30 +23,57 @@
 	 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 	 */
 
+#include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <sys/epoll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 #include <net/if.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <string.h>
 #include <time.h>
 
+#include <json-c/json.h>
+#include <zlib.h>
+
 void usage() {
-	puts("Usage: gluon-neighbour-info [-h] [-s] [-l] [-c <count>] [-t <sec>] -d <dest> -p <port> -i <if0> -r <request>");
+	puts("Usage: gluon-neighbour-info [-h] [-s] [-l] [-c <count>] [-t <sec>] [-R <count>] [-u <sec>] [-g|-S|-C] -d <dest> -p <port> -i <if0> -r <request>");
 	puts("  -p <int>         UDP port (default: 1001)");
 	puts("  -d <ip6>         destination address (unicast ip6 or multicast group, e.g. ff02:0:0:0:0:0:2:1001, default: ::1)");
 	puts("  -i <string>      interface, e.g. eth0 ");
-	puts("  -r <string>      request, e.g. nodeinfo");
+	puts("  -r <string>      request, e.g. nodeinfo, or several types separated");
+	puts("                   by spaces, e.g. \"nodeinfo statistics\" (with -g, -S or -C)");
+	puts("                   -i and -r may be given several times; all requests are");
+	puts("                   then sent on all interfaces at once and replies are");
+	puts("                   deduplicated by node_id (not with -C)");
 	puts("  -t <sec>         timeout in seconds (default: 3)");
 	puts("  -s <event>       output as server-sent events of type <event>");
 	puts("                   or without type if <event> is the empty string");
 	puts("  -c <count>       only wait for at most <count> replies");
+	puts("  -R <count>       retransmit up to <count> times with exponential");
+	puts("                   backoff; nodes known from earlier replies (with -l)");
+	puts("                   are asked by unicast, the multicast request is only");
+	puts("                   repeated while no node is known and once in the");
+	puts("                   first and every 10th round; the timeout between");
+	puts("                   retransmissions adapts to the measured round trips");
 	puts("  -l               after timeout (or <count> replies if -c is given),");
 	puts("                   send another request and loop forever");
+	puts("  -u <sec>         with -l, skip replies which are unchanged since");
+	puts("                   the node's last printed reply, for up to <sec>");
+	puts("                   seconds (matched by node_id)");
+	puts("  -g               use a compressed GET request, output the inflated");
+	puts("                   replies combined into one object per node");
+	puts("  -S               like -g, but output each data type of a reply");
+	puts("                   separately (as event of the type's name with -s)");
+	puts("  -C               compare the bytes on the wire of a GET request");
+	puts("                   and of one plain request per type, no data output");
 	puts("  -h               this help\n");
 }
 
@@ -81,9 +108,352 @@ ssize_t recvtimeout(int socket, void *buffer, size_t length, int flags, const st
 	return recv(socket, buffer, length, flags);
 }
 
-int request(const int sock, const struct sockaddr_in6 *client_addr, const char *request, const char *sse, double timeout, unsigned int max_count) {
+/*
+ * Output is collected in an iovec array and written with a single writev()
+ * once OUTPUT_FLUSH_DELAY has passed since the first unwritten message (or
+ * when the array is full), so a burst of replies doesn't cost a write per
+ * reply. Data which doesn't outlive the call is copied to output_arena.
+ */
+#define OUTPUT_IOVS 64
+#define OUTPUT_ARENA 65536
+#define OUTPUT_FLUSH_DELAY 100000 /* us */
+
+static struct iovec output_iov[OUTPUT_IOVS];
+static size_t output_n_iov;
+static char output_arena[OUTPUT_ARENA];
+static size_t output_arena_len;
+static struct timeval output_deadline;
+
+void output_flush(void) {
+	struct iovec *iov = output_iov;
+	size_t n = output_n_iov;
+
+	while (n) {
+		ssize_t ret = writev(STDOUT_FILENO, iov, n);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("writev");
+			exit(EXIT_FAILURE);
+		}
+
+		while (n && (size_t)ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			n--;
+		}
+
+		if (n) {
+			iov->iov_base = (char *)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	output_n_iov = 0;
+	output_arena_len = 0;
+}
+
+/* Static strings are referenced, everything else is copied */
+void output_add(const char *str, size_t len, bool is_static) {
+	if (!len)
+		return;
+
+	if (!is_static && output_arena_len + len > OUTPUT_ARENA)
+		output_flush();
+
+	if (!output_n_iov) {
+		getclock(&output_deadline);
+		output_deadline.tv_usec += OUTPUT_FLUSH_DELAY;
+		if (output_deadline.tv_usec >= 1000000) {
+			output_deadline.tv_usec -= 1000000;
+			output_deadline.tv_sec += 1;
+		}
+	}
+
+	if (!is_static && len > OUTPUT_ARENA) {
+		/* Too large to be copied, write it right away */
+		output_iov[output_n_iov].iov_base = (void *)str;
+		output_iov[output_n_iov].iov_len = len;
+		output_n_iov++;
+		output_flush();
+		return;
+	}
+
+	if (!is_static) {
+		char *p = output_arena + output_arena_len;
+		struct iovec *last = output_n_iov ? &output_iov[output_n_iov - 1] : NULL;
+
+		memcpy(p, str, len);
+		output_arena_len += len;
+
+		/* Extend the previous entry when the copies are adjacent */
+		if (last && (char *)last->iov_base + last->iov_len == p) {
+			last->iov_len += len;
+			return;
+		}
+
+		str = p;
+	}
+
+	output_iov[output_n_iov].iov_base = (void *)str;
+	output_iov[output_n_iov].iov_len = len;
+	output_n_iov++;
+
+	if (output_n_iov == OUTPUT_IOVS)
+		output_flush();
+}
+
+/* Writes pending output if its deadline has passed, returns true if it did */
+bool output_flush_due(void) {
+	struct timeval now;
+
+	if (!output_n_iov)
+		return false;
+
+	getclock(&now);
+	if (timercmp(&now, &output_deadline, <))
+		return false;
+
+	output_flush();
+	return true;
+}
+
+/* Lowers timeout to the deadline of pending output */
+void output_limit_timeout(struct timeval *timeout) {
+	if (output_n_iov && timercmp(&output_deadline, timeout, <))
+		*timeout = output_deadline;
+}
+
+/* Returns the ms until pending output is due or -1 if there is none */
+long output_flush_wait(void) {
+	struct timeval now, left;
+
+	if (!output_n_iov)
+		return -1;
+
+	getclock(&now);
+	if (!timercmp(&now, &output_deadline, <))
+		return 0;
+
+	tv_subtract(&left, &output_deadline, &now);
+	return left.tv_sec * 1000 + (left.tv_usec + 999) / 1000;
+}
+
+void output(const char *data, size_t len, const char *sse) {
+	if (sse) {
+		if (sse[0] != '\0') {
+			output_add("event: ", strlen("event: "), true);
+			output_add(sse, strlen(sse), false);
+			output_add("\n", 1, true);
+		}
+		output_add("data: ", strlen("data: "), true);
+	}
+
+	output_add(data, len, false);
+
+	if (sse)
+		output_add("\n\n", 2, true);
+	else
+		output_add("\n", 1, true);
+}
+
+enum mode {
+	MODE_PLAIN,
+	MODE_GET,
+	MODE_SPLIT,
+	MODE_COMPARE,
+};
+
+/* Extracts the node_id of a reply (or of the first data type of a GET reply) */
+char * get_node_id(const char *data, size_t len, enum mode mode) {
+	struct json_tokener *tok = json_tokener_new();
+	struct json_object *obj = json_tokener_parse_ex(tok, data, len);
+	struct json_object *node_id = NULL;
+	char *ret = NULL;
+
+	json_tokener_free(tok);
+
+	if (!obj || !json_object_is_type(obj, json_type_object))
+		goto out;
+
+	if (mode == MODE_PLAIN) {
+		json_object_object_get_ex(obj, "node_id", &node_id);
+	} else {
+		json_object_object_foreach(obj, type, val) {
+			(void)type;
+			if (json_object_object_get_ex(val, "node_id", &node_id))
+				break;
+		}
+	}
+
+	if (node_id && json_object_is_type(node_id, json_type_string))
+		ret = strdup(json_object_get_string(node_id));
+
+out:
+	json_object_put(obj);
+	return ret;
+}
+
+/*
+ * With -u, a reply is only printed when it differs from the last one printed
+ * for the same node and data type, or when that one is older than
+ * unchanged_timeout. Nodes are identified by their node_id; only a hash of
+ * the last reply is kept.
+ */
+struct cache_entry {
+	char *node_id;
+	char *type;
+	uint64_t hash;
+	struct timeval printed;
+};
+
+static struct cache_entry *cache;
+static size_t cache_len;
+static unsigned int unchanged_timeout;
+
+/* FNV-1a */
+uint64_t hash_data(const char *data, size_t len) {
+	uint64_t hash = 0xcbf29ce484222325;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 0x100000001b3;
+	}
+
+	return hash;
+}
+
+bool is_unchanged(const char *node_id, const char *type, const char *data, size_t len) {
+	struct cache_entry *entry = NULL;
+	uint64_t hash = hash_data(data, len);
+	struct timeval now;
+	size_t i;
+
+	if (!unchanged_timeout || !node_id)
+		return false;
+
+	if (!type)
+		type = "";
+
+	getclock(&now);
+
+	for (i = 0; i < cache_len; i++) {
+		if (!strcmp(cache[i].node_id, node_id) && !strcmp(cache[i].type, type)) {
+			entry = &cache[i];
+			break;
+		}
+	}
+
+	if (entry) {
+		if (entry->hash == hash && now.tv_sec - entry->printed.tv_sec < unchanged_timeout)
+			return true;
+	} else {
+		struct cache_entry *tmp = realloc(cache, (cache_len + 1) * sizeof(*cache));
+		if (!tmp)
+			return false;
+
+		cache = tmp;
+		entry = &cache[cache_len];
+		entry->node_id = strdup(node_id);
+		entry->type = strdup(type);
+		if (!entry->node_id || !entry->type) {
+			free(entry->node_id);
+			free(entry->type);
+			return false;
+		}
+
+		cache_len++;
+	}
+
+	entry->hash = hash;
+	entry->printed = now;
+	return false;
+}
+
+/* Replies to GET requests are deflate streams without header */
+char * inflate_reply(const char *data, size_t len, size_t *out_len) {
+	static char *out = NULL;
+	static size_t out_size = 0;
+	z_stream stream = {};
+	int ret;
+
+	if (inflateInit2(&stream, -15) != Z_OK)
+		return NULL;
+
+	stream.next_in = (Bytef *)data;
+	stream.avail_in = len;
+	*out_len = 0;
+
+	do {
+		if (out_size - *out_len < 4096) {
+			size_t size = out_size ? 2 * out_size : 65536;
+			char *tmp = realloc(out, size);
+			if (!tmp) {
+				ret = Z_MEM_ERROR;
+				break;
+			}
+
+			out = tmp;
+			out_size = size;
+		}
+
+		stream.next_out = (Bytef *)out + *out_len;
+		stream.avail_out = out_size - *out_len;
+
+		ret = inflate(&stream, Z_NO_FLUSH);
+		*out_len = out_size - stream.avail_out;
+	} while (ret == Z_OK);
+
+	inflateEnd(&stream);
+
+	if (ret != Z_STREAM_END)
+		return NULL;
+
+	return out;
+}
+
+void output_split(const char *data, size_t len, const char *sse) {
+	struct json_tokener *tok = json_tokener_new();
+	struct json_object *obj = json_tokener_parse_ex(tok, data, len);
+	json_tokener_free(tok);
+
+	if (!obj || !json_object_is_type(obj, json_type_object)) {
+		json_object_put(obj);
+		return;
+	}
+
+	json_object_object_foreach(obj, type, val) {
+		const char *str = json_object_to_json_string_ext(val, JSON_C_TO_STRING_PLAIN);
+		struct json_object *node_id;
+
+		if (json_object_object_get_ex(val, "node_id", &node_id) &&
+		    is_unchanged(json_object_get_string(node_id), type, str, strlen(str)))
+			continue;
+
+		output(str, strlen(str), sse ? type : NULL);
+	}
+
+	json_object_put(obj);
+}
+
+/* Prints an (inflated) reply, node_id is only used to suppress unchanged replies */
+void output_reply(const char *data, size_t len, enum mode mode, const char *sse, const char *node_id) {
+	if (mode == MODE_SPLIT)
+		output_split(data, len, sse);
+	else if (!is_unchanged(node_id, NULL, data, len))
+		output(data, len, sse);
+}
+
+struct stats {
+	unsigned int replies;
+	size_t bytes;
+};
+
+int request(const int sock, const struct sockaddr_in6 *client_addr, const char *request, enum mode mode, const char *sse, double timeout, unsigned int max_count, struct stats *stats) {
 	ssize_t ret;
-	char buffer[8192];
+	static char buffer[65536];
 	unsigned int count = 0;
 
 	ret = sendto(sock, request, strlen(request), 0, (struct sockaddr *)client_addr, sizeof(struct sockaddr_in6));
@@ -104,38 +474,543 @@ int request(const int sock, const struct sockaddr_in6 *client_addr, const char *
 	}
 
 	do {
-		ret = recvtimeout(sock, buffer, sizeof(buffer), 0, &tv_timeout);
+		struct timeval tv_wait = tv_timeout;
+		output_limit_timeout(&tv_wait);
+
+		ret = recvtimeout(sock, buffer, sizeof(buffer), 0, &tv_wait);
+
+		if (ret < 0) {
+			if (output_flush_due())
+				continue;
 
-		if (ret < 0)
 			break;
+		}
 
-		if (sse) {
-			if (sse[0] != '\0')
-				fprintf(stdout, "event: %s\n", sse);
-			fputs("data: ", stdout);
+		if (stats) {
+			stats->replies++;
+			stats->bytes += ret;
 		}
 
-		fwrite(buffer, sizeof(char), ret, stdout);
+		if (mode != MODE_COMPARE) {
+			const char *data = buffer;
+			size_t len = ret;
+			char *node_id = NULL;
 
-		if (sse)
-			fputs("\n\n", stdout);
-		else
-			fputs("\n", stdout);
+			if (mode != MODE_PLAIN) {
+				data = inflate_reply(buffer, ret, &len);
+				if (!data) {
+					fprintf(stderr, "Invalid compressed reply\n");
+					continue;
+				}
+			}
+
+			if (unchanged_timeout && mode != MODE_SPLIT)
+				node_id = get_node_id(data, len, mode);
+
+			output_reply(data, len, mode, sse, node_id);
+			free(node_id);
+
+			output_flush_due();
+		}
 
-		fflush(stdout);
 		count++;
 	} while (max_count == 0 || count < max_count);
 
+	output_flush();
+
 	if ((max_count == 0 && count == 0) || count < max_count)
 		return EXIT_FAILURE;
 	else
 		return EXIT_SUCCESS;
 }
 
+/*
+ * Sends the GET request once and each of the types as a plain request and
+ * prints the number of replies and bytes received for both variants
+ */
+int compare(const int sock, const struct sockaddr_in6 *client_addr, const char *types, double timeout, unsigned int max_count) {
+	struct stats get = {}, plain = {};
+	char get_request[strlen("GET ") + strlen(types) + 1];
+	char plain_request[strlen(types) + 1];
+	char *type, *saveptr;
+	int ret;
+
+	snprintf(get_request, sizeof(get_request), "GET %s", types);
+	ret = request(sock, client_addr, get_request, MODE_COMPARE, NULL, timeout, max_count, &get);
+
+	strcpy(plain_request, types);
+	for (type = strtok_r(plain_request, " ", &saveptr); type; type = strtok_r(NULL, " ", &saveptr)) {
+		if (request(sock, client_addr, type, MODE_COMPARE, NULL, timeout, max_count, &plain) != EXIT_SUCCESS)
+			ret = EXIT_FAILURE;
+	}
+
+	printf("GET:   %u replies, %zu bytes\n", get.replies, get.bytes);
+	printf("plain: %u replies, %zu bytes\n", plain.replies, plain.bytes);
+	fflush(stdout);
+
+	return ret;
+}
+
+#define MAX_IFACES 32
+#define MAX_REQUESTS 16
+/*
+ * Every buffer holds a full datagram like the one of request(); only the
+ * pages actually written by recvmmsg() are backed by memory
+ */
+#define RECV_BATCH 4
+#define RECV_BUFSIZE 65536
+
+/* Retransmission timeout before the first RTT sample and lower bound, in ms */
+#define RTO_INITIAL 500
+#define RTO_MIN 50
+
+/*
+ * The first retransmission repeats the multicast request in the first sweep
+ * and every DISCOVERY_SWEEPS sweeps after it, to find nodes whose replies
+ * have been lost before they became known
+ */
+#define DISCOVERY_SWEEPS 10
+
+struct node {
+	char *node_id;
+	/* source address of the last reply */
+	struct sockaddr_in6 addr;
+	/* the node has answered in the current sweep */
+	bool answered;
+};
+
+struct collector_request {
+	const char *request;
+	int sock;
+	/* replies in the current sweep */
+	unsigned int count;
+
+	/* all nodes which have answered this request so far */
+	struct node *nodes;
+	size_t n_nodes;
+
+	/* time of the initial request of the current sweep */
+	struct timespec sent;
+	/* RTTs are only sampled before the first retransmission (Karn) */
+	bool retransmitted;
+};
+
+struct collector {
+	const struct sockaddr_in6 *addr;
+	const unsigned int *ifindexes;
+	size_t n_ifaces;
+
+	struct collector_request reqs[MAX_REQUESTS];
+	size_t n_requests;
+
+	enum mode mode;
+	const char *sse;
+	double timeout;
+	unsigned int max_count;
+	unsigned int retries;
+
+	int efd;
+	/* number of sweeps started */
+	unsigned long sweeps;
+	/* end of the current sweep */
+	struct timespec deadline;
+
+	/* smoothed RTT and its variation in ms (RFC 6298), srtt < 0 without sample */
+	double srtt;
+	double rttvar;
+};
+
+/* Sends a request from sock via the given interface */
+int send_request(int sock, const struct sockaddr_in6 *addr, unsigned int ifindex, const char *request) {
+	char control[CMSG_SPACE(sizeof(struct in6_pktinfo))] = {};
+	struct sockaddr_in6 dest = *addr;
+	struct iovec iov = {
+		.iov_base = (void *)request,
+		.iov_len = strlen(request),
+	};
+	struct msghdr msg = {
+		.msg_name = &dest,
+		.msg_namelen = sizeof(dest),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+
+	dest.sin6_scope_id = ifindex;
+
+	if (ifindex) {
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = IPPROTO_IPV6;
+		cmsg->cmsg_type = IPV6_PKTINFO;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+		((struct in6_pktinfo *)CMSG_DATA(cmsg))->ipi6_ifindex = ifindex;
+	}
+
+	return sendmsg(sock, &msg, 0);
+}
+
+/*
+ * Records the reply of a node, returns false if the node has already
+ * answered in the current sweep
+ */
+bool mark_answered(struct collector_request *req, const char *node_id, const struct sockaddr_in6 *from) {
+	struct node *node = NULL;
+	size_t i;
+
+	for (i = 0; i < req->n_nodes; i++) {
+		if (!strcmp(req->nodes[i].node_id, node_id)) {
+			node = &req->nodes[i];
+			break;
+		}
+	}
+
+	if (node) {
+		if (node->answered)
+			return false;
+	} else {
+		struct node *nodes = realloc(req->nodes, (req->n_nodes + 1) * sizeof(*nodes));
+		if (!nodes)
+			return true;
+
+		req->nodes = nodes;
+		node = &req->nodes[req->n_nodes];
+		node->node_id = strdup(node_id);
+		if (!node->node_id)
+			return true;
+
+		req->n_nodes++;
+	}
+
+	node->addr = *from;
+	node->answered = true;
+	return true;
+}
+
+void handle_reply(struct collector_request *req, const char *buffer, size_t len,
+		  const struct sockaddr_in6 *from, enum mode mode, const char *sse) {
+	const char *data = buffer;
+
+	if (mode != MODE_PLAIN) {
+		data = inflate_reply(buffer, len, &len);
+		if (!data) {
+			fprintf(stderr, "Invalid compressed reply\n");
+			return;
+		}
+	}
+
+	char *node_id = get_node_id(data, len, mode);
+	if (node_id && !mark_answered(req, node_id, from)) {
+		free(node_id);
+		return;
+	}
+
+	output_reply(data, len, mode, sse, node_id);
+	free(node_id);
+
+	req->count++;
+}
+
+void timespec_add_ms(struct timespec *ts, long ms) {
+	ts->tv_sec += ms / 1000;
+	ts->tv_nsec += (ms % 1000) * 1000000;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_nsec -= 1000000000;
+		ts->tv_sec += 1;
+	}
+}
+
+long ms_between(const struct timespec *from, const struct timespec *to) {
+	return (to->tv_sec - from->tv_sec) * 1000 + (to->tv_nsec - from->tv_nsec) / 1000000;
+}
+
+long ms_until(const struct timespec *deadline) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	long ms = ms_between(&now, deadline);
+	return ms > 0 ? ms : 0;
+}
+
+void update_rtt(struct collector *c, long rtt) {
+	if (c->srtt < 0) {
+		c->srtt = rtt;
+		c->rttvar = rtt / 2.0;
+	} else {
+		double err = c->srtt - rtt;
+		if (err < 0)
+			err = -err;
+
+		c->rttvar = 0.75 * c->rttvar + 0.25 * err;
+		c->srtt = 0.875 * c->srtt + 0.125 * rtt;
+	}
+}
+
+long get_rto(const struct collector *c) {
+	if (c->srtt < 0)
+		return RTO_INITIAL;
+
+	long rto = c->srtt + 4 * c->rttvar;
+	return rto > RTO_MIN ? rto : RTO_MIN;
+}
+
+void collector_init(struct collector *c, const struct sockaddr_in6 *addr,
+		    const unsigned int *ifindexes, size_t n_ifaces,
+		    const char *const *requests, size_t n_requests) {
+	struct epoll_event event = {};
+	size_t i;
+
+	c->addr = addr;
+	c->ifindexes = ifindexes;
+	c->n_ifaces = n_ifaces;
+	c->n_requests = n_requests;
+	c->srtt = -1;
+
+	c->efd = epoll_create1(EPOLL_CLOEXEC);
+	if (c->efd < 0) {
+		perror("epoll_create1");
+		exit(EXIT_FAILURE);
+	}
+
+	/* One socket per request type, so every reply can be assigned to its request */
+	for (i = 0; i < n_requests; i++) {
+		struct collector_request *req = &c->reqs[i];
+
+		req->request = requests[i];
+		req->sock = socket(PF_INET6, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (req->sock < 0) {
+			perror("creating socket");
+			exit(EXIT_FAILURE);
+		}
+
+		event.events = EPOLLIN;
+		event.data.ptr = req;
+		if (epoll_ctl(c->efd, EPOLL_CTL_ADD, req->sock, &event) < 0) {
+			perror("epoll_ctl");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+bool max_count_reached(const struct collector *c, const struct collector_request *req) {
+	return c->max_count && req->count >= c->max_count;
+}
+
+bool all_max_count_reached(const struct collector *c) {
+	size_t i;
+
+	if (!c->max_count)
+		return false;
+
+	for (i = 0; i < c->n_requests; i++) {
+		if (!max_count_reached(c, &c->reqs[i]))
+			return false;
+	}
+
+	return true;
+}
+
+void send_multicast(struct collector *c, struct collector_request *req) {
+	size_t i;
+
+	for (i = 0; i < c->n_ifaces; i++) {
+		if (send_request(req->sock, c->addr, c->ifindexes[i], req->request) < 0)
+			perror("Error in sendmsg()");
+	}
+}
+
+/*
+ * Nodes which have answered in an earlier sweep, but not yet in this one,
+ * are asked again by unicast. The multicast request, which makes every node
+ * reply again, is only repeated while no node is known or for discovery.
+ * Returns false if there was nothing to send.
+ */
+bool retransmit(struct collector *c, bool discovery) {
+	bool sent = false;
+	size_t i, j;
+
+	for (i = 0; i < c->n_requests; i++) {
+		struct collector_request *req = &c->reqs[i];
+
+		if (max_count_reached(c, req))
+			continue;
+
+		if (discovery || !req->n_nodes) {
+			send_multicast(c, req);
+			req->retransmitted = true;
+			sent = true;
+		}
+
+		for (j = 0; j < req->n_nodes; j++) {
+			const struct node *node = &req->nodes[j];
+			if (node->answered)
+				continue;
+
+			if (sendto(req->sock, req->request, strlen(req->request), 0,
+				   (const struct sockaddr *)&node->addr, sizeof(node->addr)) < 0)
+				perror("Error in sendto()");
+
+			req->retransmitted = true;
+			sent = true;
+		}
+	}
+
+	return sent;
+}
+
+void receive(struct collector *c, struct collector_request *req) {
+	static char buffers[RECV_BATCH][RECV_BUFSIZE];
+	struct sockaddr_in6 addrs[RECV_BATCH];
+	struct mmsghdr msgs[RECV_BATCH];
+	struct iovec iovs[RECV_BATCH];
+	struct timespec now;
+	int i, n;
+
+	do {
+		memset(msgs, 0, sizeof(msgs));
+		for (i = 0; i < RECV_BATCH; i++) {
+			iovs[i].iov_base = buffers[i];
+			iovs[i].iov_len = sizeof(buffers[i]);
+
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		/* Drain the burst of replies which has arrived so far */
+		n = recvmmsg(req->sock, msgs, RECV_BATCH, 0, NULL);
+		if (n <= 0)
+			break;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (!req->retransmitted)
+			update_rtt(c, ms_between(&req->sent, &now));
+
+		for (i = 0; i < n; i++) {
+			if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+				fprintf(stderr, "Reply too large, ignored\n");
+				continue;
+			}
+
+			if (max_count_reached(c, req))
+				continue;
+
+			handle_reply(req, buffers[i], msgs[i].msg_len, &addrs[i], c->mode, c->sse);
+		}
+	} while (n == RECV_BATCH);
+}
+
+/*
+ * Sends all requests on all interfaces at once and collects the replies
+ * until the common deadline (or until each request got max_count replies).
+ *
+ * With retransmissions, the requests are repeated after the RTO, which is
+ * derived from the RTTs of earlier replies and doubled after every
+ * retransmission (see retransmit()). Once all nodes known from earlier
+ * sweeps have answered, no further retransmissions are sent.
+ */
+int collect(struct collector *c) {
+	struct timespec start, next_retransmit, now;
+	struct epoll_event event;
+	unsigned int retries = c->retries;
+	bool timer = retries > 0;
+	bool discovery = c->sweeps++ % DISCOVERY_SWEEPS == 0;
+	long rto = get_rto(c);
+	int ret = EXIT_SUCCESS;
+	size_t i, j;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < c->n_requests; i++) {
+		struct collector_request *req = &c->reqs[i];
+
+		req->count = 0;
+		req->sent = start;
+		req->retransmitted = false;
+
+		for (j = 0; j < req->n_nodes; j++)
+			req->nodes[j].answered = false;
+
+		send_multicast(c, req);
+	}
+
+	c->deadline = start;
+	timespec_add_ms(&c->deadline, c->timeout * 1000);
+
+	next_retransmit = start;
+	timespec_add_ms(&next_retransmit, rto);
+
+	while (!all_max_count_reached(c)) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (ms_between(&now, &c->deadline) <= 0)
+			break;
+
+		long wait = ms_until(&c->deadline);
+
+		if (timer) {
+			long until_retransmit = ms_until(&next_retransmit);
+			if (until_retransmit < wait)
+				wait = until_retransmit;
+		}
+
+		long until_flush = output_flush_wait();
+		if (until_flush >= 0 && until_flush < wait)
+			wait = until_flush;
+
+		int n = epoll_wait(c->efd, &event, 1, wait);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("epoll_wait");
+			break;
+		}
+
+		if (n > 0) {
+			receive(c, event.data.ptr);
+			output_flush_due();
+			continue;
+		}
+
+		output_flush_due();
+
+		if (timer && !ms_until(&next_retransmit)) {
+			if (!retries || !retransmit(c, discovery)) {
+				/* Wait for the remaining replies until the deadline */
+				timer = false;
+				continue;
+			}
+
+			retries--;
+			discovery = false;
+
+			rto *= 2;
+			clock_gettime(CLOCK_MONOTONIC, &next_retransmit);
+			timespec_add_ms(&next_retransmit, rto);
+		}
+	}
+
+	output_flush();
+
+	for (i = 0; i < c->n_requests; i++) {
+		const struct collector_request *req = &c->reqs[i];
+
+		if ((c->max_count == 0 && req->count == 0) || req->count < c->max_count)
+			ret = EXIT_FAILURE;
+	}
+
+	return ret;
+}
+
 int main(int argc, char **argv) {
 	int sock;
 	struct sockaddr_in6 client_addr = {};
 	char *request_string = NULL;
+	const char *requests[MAX_REQUESTS];
+	unsigned int ifindexes[MAX_IFACES] = {};
+	size_t n_requests = 0, n_ifaces = 0;
 
 	sock = socket(PF_INET6, SOCK_DGRAM, 0);
 
@@ -151,13 +1026,15 @@ int main(int argc, char **argv) {
 	opterr = 0;
 
 	int max_count = 0;
+	int retries = 0;
 	double timeout = 3.0;
 	char *sse = NULL;
 	bool loop = false;
+	enum mode mode = MODE_PLAIN;
 	int ret = false;
 
 	int c;
-	while ((c = getopt(argc, argv, "p:d:r:i:t:s:c:lh")) != -1)
+	while ((c = getopt(argc, argv, "p:d:r:i:t:s:c:R:u:lgSCh")) != -1)
 		switch (c) {
 		case 'p':
 			client_addr.sin6_port = htons(atoi(optarg));
@@ -169,14 +1046,24 @@ int main(int argc, char **argv) {
 			}
 			break;
 		case 'i':
+			if (n_ifaces == MAX_IFACES) {
+				fprintf(stderr, "Too many interfaces\n");
+				exit(EXIT_FAILURE);
+			}
 			client_addr.sin6_scope_id = if_nametoindex(optarg);
 			if (client_addr.sin6_scope_id == 0) {
 				perror("Can not use interface");
 				exit(EXIT_FAILURE);
 			}
+			ifindexes[n_ifaces++] = client_addr.sin6_scope_id;
 			break;
 		case 'r':
+			if (n_requests == MAX_REQUESTS) {
+				fprintf(stderr, "Too many requests\n");
+				exit(EXIT_FAILURE);
+			}
 			request_string = optarg;
+			requests[n_requests++] = optarg;
 			break;
 		case 't':
 			timeout = atof(optarg);
@@ -191,6 +1078,15 @@ int main(int argc, char **argv) {
 		case 'l':
 			loop = true;
 			break;
+		case 'g':
+			mode = MODE_GET;
+			break;
+		case 'S':
+			mode = MODE_SPLIT;
+			break;
+		case 'C':
+			mode = MODE_COMPARE;
+			break;
 		case 'c':
 			max_count = atoi(optarg);
 			if (max_count < 0) {
@@ -198,6 +1094,16 @@ int main(int argc, char **argv) {
 				exit(EXIT_FAILURE);
 			}
 			break;
+		case 'R':
+			retries = atoi(optarg);
+			if (retries < 0) {
+				perror("Negative retransmission count not supported");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'u':
+			unchanged_timeout = atoi(optarg);
+			break;
 		case 'h':
 			usage();
 			exit(EXIT_SUCCESS);
@@ -222,7 +1128,13 @@ int main(int argc, char **argv) {
 		exit(EXIT_FAILURE);
 	}
 
-	if (client_addr.sin6_scope_id) {
+	bool collector = n_ifaces > 1 || n_requests > 1 || retries > 0;
+	if (collector && mode == MODE_COMPARE) {
+		fprintf(stderr, "Several interfaces or requests and retransmissions are not supported with -C\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (client_addr.sin6_scope_id && !collector) {
 		if (setsockopt(
 			sock, IPPROTO_IPV6, IPV6_MULTICAST_IF,
 			&client_addr.sin6_scope_id, sizeof(client_addr.sin6_scope_id)
@@ -232,17 +1144,68 @@ int main(int argc, char **argv) {
 		}
 	}
 
+	if (mode == MODE_COMPARE) {
+		sse = NULL;
+	} else if (mode != MODE_PLAIN) {
+		for (size_t i = 0; i < n_requests; i++) {
+			char *get_request = malloc(strlen("GET ") + strlen(requests[i]) + 1);
+			if (!get_request) {
+				perror("malloc");
+				exit(EXIT_FAILURE);
+			}
+
+			sprintf(get_request, "GET %s", requests[i]);
+			requests[i] = get_request;
+		}
+
+		request_string = (char *)requests[n_requests - 1];
+	}
+
 	if (sse) {
-		fputs("Content-Type: text/event-stream\n\n", stdout);
-		fflush(stdout);
+		output_add("Content-Type: text/event-stream\n\n", strlen("Content-Type: text/event-stream\n\n"), true);
+		output_flush();
+	}
+
+	if (collector) {
+		struct collector state = {
+			.mode = mode,
+			.sse = sse,
+			.timeout = timeout,
+			.max_count = max_count,
+			.retries = retries,
+		};
+
+		collector_init(&state, &client_addr, ifindexes, n_ifaces ? n_ifaces : 1,
+			       requests, n_requests);
+
+		/* Known nodes and RTT estimates are kept across the iterations of -l */
+		do {
+			ret = collect(&state);
+
+			/* A sweep ending early doesn't shorten the request interval */
+			if (loop)
+				while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &state.deadline, NULL) == EINTR) {}
+		} while (loop);
+
+		if (sse) {
+			output_add("event: eot\ndata: null\n\n", strlen("event: eot\ndata: null\n\n"), true);
+			output_flush();
+		}
+
+		return ret;
 	}
 
 	do {
-		ret = request(sock, &client_addr, request_string, sse, timeout, max_count);
+		if (mode == MODE_COMPARE)
+			ret = compare(sock, &client_addr, request_string, timeout, max_count);
+		else
+			ret = request(sock, &client_addr, request_string, mode, sse, timeout, max_count, NULL);
 	} while(loop);
 
-	if (sse)
-		fputs("event: eot\ndata: null\n\n", stdout);
+	if (sse) {
+		output_add("event: eot\ndata: null\n\n", strlen("event: eot\ndata: null\n\n"), true);
+		output_flush();
+	}
 
 	return ret;
 }
@@ -113,7 +113,7 @@ static struct json_object * get_system(struct uci_context *ctx, struct uci_packa
 	return ret;
 }
 
-static struct json_object * respondd_provider_nodeinfo(void) {
+static struct json_object * get_nodeinfo(void) {
 	struct json_object *ret = json_object_new_object();
 
 	struct uci_context *ctx = uci_alloc_context();
@@ -139,6 +139,19 @@ static struct json_object * respondd_provider_nodeinfo(void) {
 	return ret;
 }
 
+static struct json_object * respondd_provider_nodeinfo(void) {
+	static const char *const files[] = {
+		"/etc/config/gluon-node-info",
+		NULL,
+	};
+	static struct gluonutil_json_cache cache = {
+		.ttl = GLUONUTIL_JSON_CACHE_TTL,
+		.files = files,
+	};
+
+	return gluonutil_json_cache_get(&cache, get_nodeinfo);
+}
+
 
 const struct respondd_provider_info respondd_providers[] = {
 	{"nodeinfo", respondd_provider_nodeinfo},
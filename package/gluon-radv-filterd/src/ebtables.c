@@ -0,0 +1,101 @@
+/*
+ * In-process replacement of the rules of an ebtables chain
+ *
+ * The chain is modified with the table update of libgluonutil, which
+ * exchanges the rules of the chain in one atomic replacement of the filter
+ * table, so the chain is never seen empty.
+ *
+ * The currently configured source can be read back the same way.
+ */
+
+#include "ebtables.h"
+
+#include <libgluonutil-ebtables.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define EBT_TABLE "filter"
+
+/*
+ * Replaces all rules of the given chain of the filter table by a single
+ * "-s <src> -j ACCEPT" rule (or "-j ACCEPT" if src is NULL) in one step.
+ *
+ * Returns 0 on success or a negative errno value.
+ */
+int ebt_chain_set_source(const char *chain, const struct ether_addr *src) {
+	struct gluonutil_ebt_rules rules;
+	struct ebt_entry entry = {
+		.bitmask = EBT_NOPROTO,
+	};
+	int verdict = EBT_ACCEPT;
+	int ret;
+
+	if (src) {
+		entry.bitmask |= EBT_SOURCEMAC;
+		memcpy(entry.sourcemac, src->ether_addr_octet, ETH_ALEN);
+		memset(entry.sourcemsk, 0xff, ETH_ALEN);
+	}
+
+	gluonutil_ebt_rules_init(&rules);
+
+	ret = gluonutil_ebt_rules_append(&rules, &entry, NULL, NULL, 0,
+					 EBT_STANDARD_TARGET, &verdict, sizeof(verdict));
+	if (!ret)
+		ret = gluonutil_ebt_replace_chains(EBT_TABLE, &chain, &rules, 1);
+
+	gluonutil_ebt_rules_free(&rules);
+	return ret;
+}
+
+static bool ebt_rule_is_source_accept(const struct ebt_entry *e) {
+	static const uint8_t full_mask[ETH_ALEN] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+	const struct ebt_standard_target *t =
+		(const struct ebt_standard_target *)((const char *)e + e->target_offset);
+
+	if (!(e->bitmask & EBT_SOURCEMAC) || (e->invflags & EBT_ISOURCE))
+		return false;
+
+	if (memcmp(e->sourcemsk, full_mask, ETH_ALEN))
+		return false;
+
+	return !strcmp(t->target.u.name, EBT_STANDARD_TARGET) && t->verdict == EBT_ACCEPT;
+}
+
+/*
+ * Looks up the first "-s <src> -j ACCEPT" rule of the given chain of the
+ * filter table, i.e. the source set by ebt_chain_set_source().
+ *
+ * Returns 0 on success, -ENOENT if there is no such rule or another negative
+ * errno value.
+ */
+int ebt_chain_get_source(const char *chain, struct ether_addr *src) {
+	struct gluonutil_ebt_rules rules;
+	size_t pos;
+	int ret;
+
+	gluonutil_ebt_rules_init(&rules);
+
+	ret = gluonutil_ebt_get_rules(EBT_TABLE, chain, &rules);
+	if (ret)
+		goto out;
+
+	ret = -ENOENT;
+
+	for (pos = 0; pos < rules.len; pos += ((struct ebt_entry *)(rules.data + pos))->next_offset) {
+		const struct ebt_entry *e = (const struct ebt_entry *)(rules.data + pos);
+
+		if (!ebt_rule_is_source_accept(e))
+			continue;
+
+		memcpy(src->ether_addr_octet, e->sourcemac, ETH_ALEN);
+		ret = 0;
+		break;
+	}
+
+out:
+	gluonutil_ebt_rules_free(&rules);
+	return ret;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <net/ethernet.h>
+
+int ebt_chain_set_source(const char *chain, const struct ether_addr *src);
+int ebt_chain_get_source(const char *chain, struct ether_addr *src);
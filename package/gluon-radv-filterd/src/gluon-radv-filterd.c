@@ -36,8 +36,9 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <sys/epoll.h>
 #include <sys/socket.h>
-#include <sys/select.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
@@ -57,15 +58,16 @@
 #include <netlink/genl/ctrl.h>
 #include <batadv-genl.h>
 
+#include "ebtables.h"
 #include "mac.h"
 
-// Recheck TQs after this time even if no RA was received
-#define MAX_INTERVAL 60
+// Recheck TQs this often, even if no new router has been seen, so a
+// degrading or vanishing selected router is noticed in time
+#define UPDATE_INTERVAL 15
 
-// Recheck TQs at most this often, even if new RAs were received (they won't
-// become the preferred routers until the TQs have been rechecked)
-// Also, the first update will take at least this long
-#define MIN_INTERVAL 15
+// Delay of the recheck after a new router has been seen (in seconds), so
+// that RAs arriving at about the same time are handled by a single update
+#define UPDATE_DELAY 1
 
 // Remember the originator of a router for at most this period of time (in
 // seconds). Re-read it from the transtable afterwards.
@@ -77,6 +79,9 @@
 // TQ value assigned to local routers
 #define LOCAL_TQ 512
 
+// number of buckets of the router hash indexes (power of two)
+#define ROUTER_HASH_SIZE 64
+
 #define BUFSIZE 1500
 
 #ifdef DEBUG
@@ -105,6 +110,12 @@
 
 struct router {
 	struct router *next;
+	// chain in G.routers_src, hashed by src
+	struct router *src_next;
+	struct router **src_pprev;
+	// chain in G.routers_orig, hashed by originator (if known)
+	struct router *orig_next;
+	struct router **orig_pprev;
 	struct ether_addr src;
 	struct timespec eol;
 	struct ether_addr originator;
@@ -113,14 +124,23 @@ struct router {
 
 static struct global {
 	int sock;
+	int epoll_fd;
+	int timer_fd;
+	struct timespec next_update;
+	struct timespec next_invalidation;
 	struct router *routers;
+	struct router *routers_src[ROUTER_HASH_SIZE];
+	struct router *routers_orig[ROUTER_HASH_SIZE];
 	const char *mesh_iface;
+	struct batadv_genl_session batadv;
 	const char *chain;
 	uint16_t max_tq;
 	uint16_t hysteresis_thresh;
 	struct router *best_router;
 	volatile sig_atomic_t stop_daemon;
 } G = {
+	.epoll_fd = -1,
+	.timer_fd = -1,
 	.mesh_iface = "bat0",
 };
 
@@ -161,7 +181,10 @@ static void cleanup(void) {
 		.tv_nsec = EBTABLES_TIMEOUT,
 	};
 
+	close(G.timer_fd);
+	close(G.epoll_fd);
 	close(G.sock);
+	batadv_genl_session_close(&G.batadv);
 
 	while (G.routers != NULL) {
 		router = G.routers;
@@ -171,12 +194,17 @@ static void cleanup(void) {
 
 	if (G.chain) {
 		/* Reset chain to accept everything again */
+		if (ebt_chain_set_source(G.chain, NULL) == 0)
+			return;
+
+		DEBUG_MSG("warning: resetting ebtables chain %s in-process failed, falling back to ebtables-tiny", G.chain);
+
 		if (fork_execvp_timeout(&timeout, "ebtables-tiny", (const char *[])
-				{ "ebtables-tiny", "-F", G.chain, NULL }))
+				{ "ebtables-tiny", "--concurrent", "-F", G.chain, NULL }))
 			DEBUG_MSG("warning: flushing ebtables chain %s failed, not adding a new rule", G.chain);
 
 		if (fork_execvp_timeout(&timeout, "ebtables-tiny", (const char *[])
-				{ "ebtables-tiny", "-A", G.chain, "-j", "ACCEPT", NULL }))
+				{ "ebtables-tiny", "--concurrent", "-A", G.chain, "-j", "ACCEPT", NULL }))
 			DEBUG_MSG("warning: adding new rule to ebtables chain %s failed", G.chain);
 	}
 }
@@ -221,23 +249,46 @@ static inline void warn_errno(const char *message) {
 }
 
 static int init_packet_socket(unsigned int ifindex) {
+	// The socket is bound at the network layer, so offsets are relative to
+	// the IPv6 header. Up to one hop-by-hop options header (as used by MLD
+	// router alert) is skipped; the offset of the ICMPv6 header is kept in X.
+	// Only the headers up to the end of the RA header are copied to userspace.
 	struct sock_filter radv_filter_code[] = {
-		// check that this is an ICMPv6 packet
-		BPF_STMT(BPF_LD|BPF_B|BPF_ABS, offsetof(struct ip6_hdr, ip6_nxt)),
-		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, IPPROTO_ICMPV6, 0, 7),
+		// check that this is an IPv6 packet
+		/*  0 */ BPF_STMT(BPF_LD|BPF_W|BPF_ABS, SKF_AD_OFF + SKF_AD_PROTOCOL),
+		/*  1 */ BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, ETH_P_IPV6, 0, 24),
+		/*  2 */ BPF_STMT(BPF_LD|BPF_B|BPF_ABS, 0),
+		/*  3 */ BPF_STMT(BPF_ALU|BPF_AND|BPF_K, 0xf0),
+		/*  4 */ BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0x60, 0, 21),
+		// check that this is an ICMPv6 packet, possibly behind a hop-by-hop options header
+		/*  5 */ BPF_STMT(BPF_LD|BPF_B|BPF_ABS, offsetof(struct ip6_hdr, ip6_nxt)),
+		/*  6 */ BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, IPPROTO_ICMPV6, 9, 0),
+		/*  7 */ BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, IPPROTO_HOPOPTS, 0, 18),
+		/*  8 */ BPF_STMT(BPF_LD|BPF_B|BPF_ABS, sizeof(struct ip6_hdr) + offsetof(struct ip6_hbh, ip6h_nxt)),
+		/*  9 */ BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, IPPROTO_ICMPV6, 0, 16),
+		// X = sizeof(struct ip6_hdr) + (ip6h_len + 1) * 8
+		/* 10 */ BPF_STMT(BPF_LD|BPF_B|BPF_ABS, sizeof(struct ip6_hdr) + offsetof(struct ip6_hbh, ip6h_len)),
+		/* 11 */ BPF_STMT(BPF_ALU|BPF_ADD|BPF_K, 1),
+		/* 12 */ BPF_STMT(BPF_ALU|BPF_LSH|BPF_K, 3),
+		/* 13 */ BPF_STMT(BPF_ALU|BPF_ADD|BPF_K, sizeof(struct ip6_hdr)),
+		/* 14 */ BPF_STMT(BPF_MISC|BPF_TAX, 0),
+		/* 15 */ BPF_JUMP(BPF_JMP|BPF_JA, 1, 0, 0),
+		/* 16 */ BPF_STMT(BPF_LDX|BPF_W|BPF_IMM, sizeof(struct ip6_hdr)),
 		// check that this is a router advertisement
-		BPF_STMT(BPF_LD|BPF_B|BPF_ABS, sizeof(struct ip6_hdr) + offsetof(struct icmp6_hdr, icmp6_type)),
-		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, ND_ROUTER_ADVERT, 0, 5),
+		/* 17 */ BPF_STMT(BPF_LD|BPF_B|BPF_IND, offsetof(struct icmp6_hdr, icmp6_type)),
+		/* 18 */ BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, ND_ROUTER_ADVERT, 0, 7),
 		// check that the code field in the ICMPv6 header is 0
-		BPF_STMT(BPF_LD|BPF_B|BPF_ABS, sizeof(struct ip6_hdr) + offsetof(struct nd_router_advert, nd_ra_code)),
-		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0, 0, 3),
+		/* 19 */ BPF_STMT(BPF_LD|BPF_B|BPF_IND, offsetof(struct nd_router_advert, nd_ra_code)),
+		/* 20 */ BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0, 0, 5),
 		// check that this is a default route (lifetime > 0)
-		BPF_STMT(BPF_LD|BPF_H|BPF_ABS, sizeof(struct ip6_hdr) + offsetof(struct nd_router_advert, nd_ra_router_lifetime)),
-		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0, 1, 0),
-		// return true
-		BPF_STMT(BPF_RET|BPF_K, 0xffffffff),
+		/* 21 */ BPF_STMT(BPF_LD|BPF_H|BPF_IND, offsetof(struct nd_router_advert, nd_ra_router_lifetime)),
+		/* 22 */ BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0, 3, 0),
+		// return true, truncated to the end of the RA header
+		/* 23 */ BPF_STMT(BPF_MISC|BPF_TXA, 0),
+		/* 24 */ BPF_STMT(BPF_ALU|BPF_ADD|BPF_K, sizeof(struct nd_router_advert)),
+		/* 25 */ BPF_STMT(BPF_RET|BPF_A, 0),
 		// return false
-		BPF_STMT(BPF_RET|BPF_K, 0),
+		/* 26 */ BPF_STMT(BPF_RET|BPF_K, 0),
 	};
 
 	struct sock_fprog radv_filter = {
@@ -245,7 +296,8 @@ static int init_packet_socket(unsigned int ifindex) {
 	    .filter = radv_filter_code,
 	};
 
-	int sock = socket(AF_PACKET, SOCK_DGRAM|SOCK_CLOEXEC, htons(ETH_P_IPV6));
+	// Don't receive anything before the filter is attached
+	int sock = socket(AF_PACKET, SOCK_DGRAM|SOCK_CLOEXEC, 0);
 	if (sock < 0)
 		exit_errno("can't open packet socket");
 	int ret = setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &radv_filter, sizeof(radv_filter));
@@ -303,10 +355,51 @@ static void parse_cmdline(int argc, char *argv[]) {
 	}
 }
 
+static unsigned int router_hash(const struct ether_addr *mac) {
+	unsigned int hash = 0;
+	size_t i;
+
+	for (i = 0; i < ETH_ALEN; i++)
+		hash = hash * 31 + mac->ether_addr_octet[i];
+
+	return hash % ROUTER_HASH_SIZE;
+}
+
+static void router_unhash_orig(struct router *router) {
+	if (!router->orig_pprev)
+		return;
+
+	*router->orig_pprev = router->orig_next;
+	if (router->orig_next)
+		router->orig_next->orig_pprev = router->orig_pprev;
+
+	router->orig_next = NULL;
+	router->orig_pprev = NULL;
+}
+
+static void router_set_originator(struct router *router,
+				  const struct ether_addr *orig) {
+	static const struct ether_addr unspec = {};
+	struct router **head;
+
+	router_unhash_orig(router);
+	router->originator = *orig;
+
+	if (ether_addr_equal(*orig, unspec))
+		return;
+
+	head = &G.routers_orig[router_hash(orig)];
+	router->orig_next = *head;
+	router->orig_pprev = head;
+	if (*head)
+		(*head)->orig_pprev = &router->orig_next;
+	*head = router;
+}
+
 static struct router *router_find_src(const struct ether_addr *src) {
 	struct router *router;
 
-	foreach(router, G.routers) {
+	for (router = G.routers_src[router_hash(src)]; router; router = router->src_next) {
 		if (ether_addr_equal(router->src, *src))
 			return router;
 	}
@@ -314,10 +407,18 @@ static struct router *router_find_src(const struct ether_addr *src) {
 	return NULL;
 }
 
-static struct router *router_find_orig(const struct ether_addr *orig) {
+// returns the next router after prev (or the first one if prev is NULL)
+// with the given originator
+static struct router *router_find_orig(const struct ether_addr *orig,
+				       struct router *prev) {
 	struct router *router;
 
-	foreach(router, G.routers) {
+	if (prev)
+		router = prev->orig_next;
+	else
+		router = G.routers_orig[router_hash(orig)];
+
+	for (; router; router = router->orig_next) {
 		if (ether_addr_equal(router->originator, *orig))
 			return router;
 	}
@@ -326,6 +427,8 @@ static struct router *router_find_orig(const struct ether_addr *orig) {
 }
 
 static struct router *router_add(const struct ether_addr *mac) {
+	static const struct ether_addr unspec = {};
+	struct router **head;
 	struct router *router;
 
 	router = malloc(sizeof(*router));
@@ -337,19 +440,54 @@ static struct router *router_add(const struct ether_addr *mac) {
 	G.routers = router;
 	router->eol.tv_sec = 0;
 	router->eol.tv_nsec = 0;
-	memset(&router->originator, 0, sizeof(router->originator));
+	router->tq = 0;
+	router->orig_next = NULL;
+	router->orig_pprev = NULL;
+	router_set_originator(router, &unspec);
+
+	head = &G.routers_src[router_hash(mac)];
+	router->src_next = *head;
+	router->src_pprev = head;
+	if (*head)
+		(*head)->src_pprev = &router->src_next;
+	*head = router;
 
 	return router;
 }
 
+static void router_remove(struct router *router) {
+	*router->src_pprev = router->src_next;
+	if (router->src_next)
+		router->src_next->src_pprev = router->src_pprev;
+
+	router_unhash_orig(router);
+}
+
+// Makes sure that the TQs are rechecked in at most delay seconds
+static void schedule_update(time_t delay) {
+	struct timespec next;
+	struct timespec diff;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	next.tv_sec += delay;
+
+	if ((G.next_update.tv_sec == 0 && G.next_update.tv_nsec == 0) ||
+	    timespec_diff(&G.next_update, &next, &diff))
+		G.next_update = next;
+}
+
 static void router_update(const struct ether_addr *mac, uint16_t timeout) {
 	struct router *router;
 
 	router = router_find_src(mac);
-	if (!router)
+	if (!router) {
 		router = router_add(mac);
-	if (!router)
-		return;
+		if (!router)
+			return;
+
+		DEBUG_MSG("new router " F_MAC ", rechecking TQs soon", F_MAC_VAR(*mac));
+		schedule_update(UPDATE_DELAY);
+	}
 
 	clock_gettime(CLOCK_MONOTONIC, &router->eol);
 	router->eol.tv_sec += timeout;
@@ -360,22 +498,35 @@ static void handle_ra(int sock) {
 	struct ether_addr mac;
 	socklen_t addr_size = sizeof(src);
 	ssize_t len;
-	struct {
-		struct ip6_hdr ip6;
-		struct nd_router_advert ra;
-	} pkt;
-
-	len = recvfrom(sock, &pkt, sizeof(pkt), 0, (struct sockaddr *)&src, &addr_size);
+	size_t offset = sizeof(struct ip6_hdr);
+	const struct ip6_hdr *ip6;
+	const struct ip6_hbh *hbh;
+	const struct nd_router_advert *ra;
+	// IPv6 header, largest possible hop-by-hop header, RA header
+	uint8_t pkt[sizeof(struct ip6_hdr) + 256*8 + sizeof(struct nd_router_advert)]
+		__attribute__((aligned(4)));
+
+	len = recvfrom(sock, pkt, sizeof(pkt), 0, (struct sockaddr *)&src, &addr_size);
 	CHECK(len >= 0);
 
 	// BPF already checked that this is an ICMPv6 RA of a default router
-	CHECK((size_t)len >= sizeof(pkt));
-	CHECK(ntohs(pkt.ip6.ip6_plen) + sizeof(struct ip6_hdr) >= sizeof(pkt));
+	// and truncated the packet after the RA header
+	CHECK((size_t)len >= offset);
+	ip6 = (const struct ip6_hdr *)pkt;
+	if (ip6->ip6_nxt == IPPROTO_HOPOPTS) {
+		CHECK((size_t)len >= offset + sizeof(*hbh));
+		hbh = (const struct ip6_hbh *)(pkt + offset);
+		offset += (hbh->ip6h_len + 1) * 8;
+	}
+
+	CHECK((size_t)len >= offset + sizeof(*ra));
+	CHECK(ntohs(ip6->ip6_plen) + sizeof(struct ip6_hdr) >= offset + sizeof(*ra));
+	ra = (const struct nd_router_advert *)(pkt + offset);
 
 	memcpy(&mac, src.sll_addr, sizeof(mac));
 	DEBUG_MSG("received valid RA from " F_MAC, F_MAC_VAR(mac));
 
-	router_update(&mac, ntohs(pkt.ra.nd_ra_router_lifetime));
+	router_update(&mac, ntohs(ra->nd_ra_router_lifetime));
 
 check_failed:
 	return;
@@ -394,8 +545,12 @@ static void expire_routers(void) {
 		if (timespec_diff(&now, &router->eol, &diff)) {
 			DEBUG_MSG("router " F_MAC " expired", F_MAC_VAR(router->src));
 			*prev_ptr = router->next;
-			if (G.best_router == router)
+			router_remove(router);
+			if (G.best_router == router) {
+				// elect a new router right away
 				G.best_router = NULL;
+				schedule_update(0);
+			}
 			free(router);
 		} else {
 			prev_ptr = &router->next;
@@ -403,43 +558,34 @@ static void expire_routers(void) {
 	}
 }
 
+enum {
+	TT_GLOBAL_ATTR_ADDRESS,
+	TT_GLOBAL_ATTR_ORIG_ADDRESS,
+	TT_GLOBAL_ATTR_FLAG_BEST,
+	TT_GLOBAL_ATTR_NUM,
+};
+
 static int parse_tt_global(struct nl_msg *msg,
 			   void *arg __attribute__((unused)))
 {
-	static const enum batadv_nl_attrs mandatory[] = {
-		BATADV_ATTR_TT_ADDRESS,
-		BATADV_ATTR_ORIG_ADDRESS,
+	static const struct batadv_genl_attr_spec spec[TT_GLOBAL_ATTR_NUM] = {
+		[TT_GLOBAL_ATTR_ADDRESS] = { BATADV_ATTR_TT_ADDRESS, true },
+		[TT_GLOBAL_ATTR_ORIG_ADDRESS] = { BATADV_ATTR_ORIG_ADDRESS, true },
+		[TT_GLOBAL_ATTR_FLAG_BEST] = { BATADV_ATTR_FLAG_BEST, true },
 	};
-	struct nlattr *attrs[BATADV_ATTR_MAX + 1];
-	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct nlattr *attrs[TT_GLOBAL_ATTR_NUM];
 	struct ether_addr mac_a, mac_b;
-	struct genlmsghdr *ghdr;
 	struct router *router;
 	uint8_t *addr;
 	uint8_t *orig;
 
-	// parse netlink entry
-	if (!genlmsg_valid_hdr(nlh, 0))
-		return NL_OK;
-
-	ghdr = nlmsg_data(nlh);
-
-	if (ghdr->cmd != BATADV_CMD_GET_TRANSTABLE_GLOBAL)
+	// parse netlink entry, only best entries are interesting
+	if (batadv_genl_parse(msg, BATADV_CMD_GET_TRANSTABLE_GLOBAL, spec,
+			      attrs, TT_GLOBAL_ATTR_NUM))
 		return NL_OK;
 
-	if (nla_parse(attrs, BATADV_ATTR_MAX, genlmsg_attrdata(ghdr, 0),
-		      genlmsg_len(ghdr), batadv_genl_policy)) {
-		return NL_OK;
-	}
-
-	if (batadv_genl_missing_attrs(attrs, mandatory, ARRAY_SIZE(mandatory)))
-		return NL_OK;
-
-	addr = nla_data(attrs[BATADV_ATTR_TT_ADDRESS]);
-	orig = nla_data(attrs[BATADV_ATTR_ORIG_ADDRESS]);
-
-	if (!attrs[BATADV_ATTR_FLAG_BEST])
-		return NL_OK;
+	addr = nla_data(attrs[TT_GLOBAL_ATTR_ADDRESS]);
+	orig = nla_data(attrs[TT_GLOBAL_ATTR_ORIG_ADDRESS]);
 
 	MAC2ETHER(mac_a, addr);
 	MAC2ETHER(mac_b, orig);
@@ -451,97 +597,77 @@ static int parse_tt_global(struct nl_msg *msg,
 
 	DEBUG_MSG("Found originator for " F_MAC ", it's " F_MAC,
 		  F_MAC_VAR(router->src), F_MAC_VAR(mac_b));
-	router->originator = mac_b;
+	router_set_originator(router, &mac_b);
 
 	return NL_OK;
 }
 
+enum {
+	ORIG_ATTR_ORIG_ADDRESS,
+	ORIG_ATTR_TQ,
+	ORIG_ATTR_FLAG_BEST,
+	ORIG_ATTR_NUM,
+};
+
 static int parse_originator(struct nl_msg *msg,
 			    void *arg __attribute__((unused)))
 {
-
-	static const enum batadv_nl_attrs mandatory[] = {
-		BATADV_ATTR_ORIG_ADDRESS,
-		BATADV_ATTR_TQ,
+	static const struct batadv_genl_attr_spec spec[ORIG_ATTR_NUM] = {
+		[ORIG_ATTR_ORIG_ADDRESS] = { BATADV_ATTR_ORIG_ADDRESS, true },
+		[ORIG_ATTR_TQ] = { BATADV_ATTR_TQ, true },
+		[ORIG_ATTR_FLAG_BEST] = { BATADV_ATTR_FLAG_BEST, true },
 	};
-	struct nlattr *attrs[BATADV_ATTR_MAX + 1];
-	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct nlattr *attrs[ORIG_ATTR_NUM];
 	struct ether_addr mac_a;
-	struct genlmsghdr *ghdr;
 	struct router *router;
 	uint8_t *orig;
 	uint8_t tq;
 
-	// parse netlink entry
-	if (!genlmsg_valid_hdr(nlh, 0))
-		return NL_OK;
-
-	ghdr = nlmsg_data(nlh);
-
-	if (ghdr->cmd != BATADV_CMD_GET_ORIGINATORS)
-		return NL_OK;
-
-	if (nla_parse(attrs, BATADV_ATTR_MAX, genlmsg_attrdata(ghdr, 0),
-		      genlmsg_len(ghdr), batadv_genl_policy)) {
+	// parse netlink entry, only best entries are interesting
+	if (batadv_genl_parse(msg, BATADV_CMD_GET_ORIGINATORS, spec, attrs,
+			      ORIG_ATTR_NUM))
 		return NL_OK;
-	}
 
-	if (batadv_genl_missing_attrs(attrs, mandatory, ARRAY_SIZE(mandatory)))
-		return NL_OK;
-
-	orig = nla_data(attrs[BATADV_ATTR_ORIG_ADDRESS]);
-	tq = nla_get_u8(attrs[BATADV_ATTR_TQ]);
-
-	if (!attrs[BATADV_ATTR_FLAG_BEST])
-		return NL_OK;
+	orig = nla_data(attrs[ORIG_ATTR_ORIG_ADDRESS]);
+	tq = nla_get_u8(attrs[ORIG_ATTR_TQ]);
 
 	MAC2ETHER(mac_a, orig);
 
-	// update router
-	router = router_find_orig(&mac_a);
-	if (!router)
-		return NL_OK;
-
-	DEBUG_MSG("Found TQ for router " F_MAC " (originator " F_MAC "), it's %d",
-		  F_MAC_VAR(router->src), F_MAC_VAR(router->originator), tq);
-	router->tq = tq;
-	if (router->tq > G.max_tq)
-		G.max_tq = router->tq;
+	// update all routers behind this originator
+	router = NULL;
+	while ((router = router_find_orig(&mac_a, router)) != NULL) {
+		DEBUG_MSG("Found TQ for router " F_MAC " (originator " F_MAC "), it's %d",
+			  F_MAC_VAR(router->src), F_MAC_VAR(router->originator), tq);
+		router->tq = tq;
+		if (router->tq > G.max_tq)
+			G.max_tq = router->tq;
+	}
 
 	return NL_OK;
 }
 
+enum {
+	TT_LOCAL_ATTR_ADDRESS,
+	TT_LOCAL_ATTR_NUM,
+};
+
 static int parse_tt_local(struct nl_msg *msg,
 			  void *arg __attribute__((unused)))
 {
-	static const enum batadv_nl_attrs mandatory[] = {
-		BATADV_ATTR_TT_ADDRESS,
+	static const struct batadv_genl_attr_spec spec[TT_LOCAL_ATTR_NUM] = {
+		[TT_LOCAL_ATTR_ADDRESS] = { BATADV_ATTR_TT_ADDRESS, true },
 	};
-	struct nlattr *attrs[BATADV_ATTR_MAX + 1];
-	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct nlattr *attrs[TT_LOCAL_ATTR_NUM];
 	struct ether_addr mac_a;
-	struct genlmsghdr *ghdr;
 	struct router *router;
 	uint8_t *addr;
 
 	// parse netlink entry
-	if (!genlmsg_valid_hdr(nlh, 0))
-		return NL_OK;
-
-	ghdr = nlmsg_data(nlh);
-
-	if (ghdr->cmd != BATADV_CMD_GET_TRANSTABLE_LOCAL)
-		return NL_OK;
-
-	if (nla_parse(attrs, BATADV_ATTR_MAX, genlmsg_attrdata(ghdr, 0),
-		      genlmsg_len(ghdr), batadv_genl_policy)) {
+	if (batadv_genl_parse(msg, BATADV_CMD_GET_TRANSTABLE_LOCAL, spec,
+			      attrs, TT_LOCAL_ATTR_NUM))
 		return NL_OK;
-	}
 
-	if (batadv_genl_missing_attrs(attrs, mandatory, ARRAY_SIZE(mandatory)))
-		return NL_OK;
-
-	addr = nla_data(attrs[BATADV_ATTR_TT_ADDRESS]);
+	addr = nla_data(attrs[TT_LOCAL_ATTR_ADDRESS]);
 	MAC2ETHER(mac_a, addr);
 
 	// update router
@@ -562,8 +688,11 @@ static void update_tqs(void) {
 	static const struct ether_addr unspec = {};
 	struct router *router;
 	bool update_originators = false;
-	struct batadv_nlquery_opts opts;
-	int ret;
+	struct batadv_nlquery_opts tt_global_opts = {};
+	struct batadv_nlquery_opts orig_opts = {};
+	struct batadv_nlquery_opts tt_local_opts = {};
+	struct batadv_genl_dump dumps[3];
+	size_t num_dumps = 0;
 
 	// reset TQs
 	foreach(router, G.routers) {
@@ -573,49 +702,54 @@ static void update_tqs(void) {
 	}
 
 	// translate all router's MAC addresses to originators simultaneously
-	if (update_originators) {
-		opts.err = 0;
-		ret = batadv_genl_query(G.mesh_iface,
-					BATADV_CMD_GET_TRANSTABLE_GLOBAL,
-					parse_tt_global, NLM_F_DUMP, &opts);
-		if (ret < 0)
-			fprintf(stderr, "Parsing of global translation table failed\n");
-	}
+	if (update_originators)
+		dumps[num_dumps++] = (struct batadv_genl_dump) {
+			.cmd = BATADV_CMD_GET_TRANSTABLE_GLOBAL,
+			.callback = parse_tt_global,
+			.query_opts = &tt_global_opts,
+		};
 
 	// look up TQs of originators
+	dumps[num_dumps++] = (struct batadv_genl_dump) {
+		.cmd = BATADV_CMD_GET_ORIGINATORS,
+		.callback = parse_originator,
+		.query_opts = &orig_opts,
+	};
+
+	// routers in the local translation table get LOCAL_TQ; the table is
+	// small, so it is always dumped along with the others
+	dumps[num_dumps++] = (struct batadv_genl_dump) {
+		.cmd = BATADV_CMD_GET_TRANSTABLE_LOCAL,
+		.callback = parse_tt_local,
+		.query_opts = &tt_local_opts,
+	};
+
 	G.max_tq = 0;
-	opts.err = 0;
-	ret = batadv_genl_query(G.mesh_iface,
-				BATADV_CMD_GET_ORIGINATORS,
-				parse_originator, NLM_F_DUMP, &opts);
-	if (ret < 0)
-		fprintf(stderr, "Parsing of originators failed\n");
+	batadv_genl_session_dump(&G.batadv, dumps, num_dumps);
 
-	// if all routers have a TQ value, we don't need to check translocal
-	foreach(router, G.routers) {
-		if (router->tq == 0)
-			break;
-	}
-	if (router != NULL) {
-		opts.err = 0;
-		ret = batadv_genl_query(G.mesh_iface,
-					BATADV_CMD_GET_TRANSTABLE_LOCAL,
-					parse_tt_local, NLM_F_DUMP, &opts);
-		if (ret < 0)
-			fprintf(stderr, "Parsing of global translation table failed\n");
-	}
+	if (tt_global_opts.err < 0)
+		fprintf(stderr, "Parsing of global translation table failed\n");
+	if (orig_opts.err < 0)
+		fprintf(stderr, "Parsing of originators failed\n");
+	if (tt_local_opts.err < 0)
+		fprintf(stderr, "Parsing of local translation table failed\n");
 
 	foreach(router, G.routers) {
 		if (router->tq == 0) {
-			if (ether_addr_equal(router->originator, unspec))
+			if (ether_addr_equal(router->originator, unspec)) {
 				DEBUG_MSG(
 					"Unable to find router " F_MAC " in transtable_{global,local}",
 					F_MAC_VAR(router->src));
-			else
+			} else {
 				DEBUG_MSG(
 					"Unable to find TQ for originator " F_MAC " (router " F_MAC ")",
 					F_MAC_VAR(router->originator),
 					F_MAC_VAR(router->src));
+
+				// the router has probably roamed to another
+				// originator, look it up again next time
+				router_set_originator(router, &unspec);
+			}
 		}
 	}
 }
@@ -695,6 +829,7 @@ static void update_ebtables(void) {
 	};
 	char mac[F_MAC_LEN + 1];
 	struct router *router;
+	int ret;
 
 	if (!election_required()) {
 		DEBUG_MSG(F_MAC " is still good enough with TQ=%d (max_tq=%d), not executing ebtables",
@@ -722,11 +857,17 @@ static void update_ebtables(void) {
 			G.max_tq);
 	G.best_router = router;
 
+	ret = ebt_chain_set_source(G.chain, &router->src);
+	if (ret == 0)
+		return;
+
+	error_message(0, -ret, "warning: updating ebtables chain %s in-process failed, falling back to ebtables-tiny", G.chain);
+
 	if (fork_execvp_timeout(&timeout, "ebtables-tiny", (const char *[])
-			{ "ebtables-tiny", "-F", G.chain, NULL }))
+			{ "ebtables-tiny", "--concurrent", "-F", G.chain, NULL }))
 		error_message(0, 0, "warning: flushing ebtables chain %s failed, not adding a new rule", G.chain);
 	else if (fork_execvp_timeout(&timeout, "ebtables-tiny", (const char *[])
-			{ "ebtables-tiny", "-A", G.chain, "-s", mac, "-j", "ACCEPT", NULL }))
+			{ "ebtables-tiny", "--concurrent", "-A", G.chain, "-s", mac, "-j", "ACCEPT", NULL }))
 		error_message(0, 0, "warning: adding new rule to ebtables chain %s failed", G.chain);
 }
 
@@ -735,7 +876,11 @@ static void invalidate_originators(void)
 	struct router *router;
 	foreach(router, G.routers) {
 		memset(&router->originator, 0, sizeof(router->originator));
+		router->orig_next = NULL;
+		router->orig_pprev = NULL;
 	}
+
+	memset(G.routers_orig, 0, sizeof(G.routers_orig));
 }
 
 static void sighandler(int sig __attribute__((unused)))
@@ -743,20 +888,90 @@ static void sighandler(int sig __attribute__((unused)))
 	G.stop_daemon = 1;
 }
 
-int main(int argc, char *argv[]) {
-	int retval;
-	fd_set rfds;
-	struct timeval tv;
-	struct timespec next_update;
-	struct timespec next_invalidation;
+static void update_timer(void) {
+	struct itimerspec timer = {};
+	struct router *router;
+	struct timespec diff;
+
+	if (G.routers) {
+		timer.it_value = G.next_update;
+
+		// wake up when the next router expires
+		foreach(router, G.routers) {
+			if (timespec_diff(&timer.it_value, &router->eol, &diff))
+				timer.it_value = router->eol;
+		}
+
+		// an all-zero it_value would disarm the timer
+		if (timer.it_value.tv_sec == 0 && timer.it_value.tv_nsec == 0)
+			timer.it_value.tv_nsec = 1;
+	}
+
+	if (timerfd_settime(G.timer_fd, TFD_TIMER_ABSTIME, &timer, NULL) < 0)
+		exit_errno("can't set timer");
+}
+
+static void handle_timer(void) {
 	struct timespec now;
 	struct timespec diff;
+	uint64_t expirations;
+
+	if (read(G.timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+		warn_errno("can't read timer");
+
+	expire_routers();
+
+	// all routers could have expired
+	if (G.routers == NULL) {
+		G.next_update.tv_sec = 0;
+		G.next_update.tv_nsec = 0;
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!timespec_diff(&now, &G.next_update, &diff))
+		return;
+
+	if (timespec_diff(&now, &G.next_invalidation, &diff)) {
+		invalidate_originators();
+
+		G.next_invalidation = now;
+		G.next_invalidation.tv_sec += ORIGINATOR_CACHE_TTL;
+	}
+
+	update_tqs();
+	update_ebtables();
+
+	G.next_update = now;
+	G.next_update.tv_sec += UPDATE_INTERVAL;
+}
+
+static void init_epoll(void) {
+	struct epoll_event event = {
+		.events = EPOLLIN,
+	};
 
-	clock_gettime(CLOCK_MONOTONIC, &next_update);
-	next_update.tv_sec += MIN_INTERVAL;
+	G.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (G.epoll_fd < 0)
+		exit_errno("can't create epoll instance");
 
-	clock_gettime(CLOCK_MONOTONIC, &next_invalidation);
-	next_invalidation.tv_sec += MIN_INTERVAL;
+	G.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+	if (G.timer_fd < 0)
+		exit_errno("can't create timer");
+
+	event.data.fd = G.sock;
+	if (epoll_ctl(G.epoll_fd, EPOLL_CTL_ADD, G.sock, &event) < 0)
+		exit_errno("can't add packet socket to epoll instance");
+
+	event.data.fd = G.timer_fd;
+	if (epoll_ctl(G.epoll_fd, EPOLL_CTL_ADD, G.timer_fd, &event) < 0)
+		exit_errno("can't add timer to epoll instance");
+}
+
+int main(int argc, char *argv[]) {
+	struct epoll_event events[2];
+	int nevents;
+	int i;
 
 	G.sock = -1;
 	parse_cmdline(argc, argv);
@@ -767,50 +982,34 @@ int main(int argc, char *argv[]) {
 	if (G.chain == NULL)
 		usage("No chain set!");
 
+	if (batadv_genl_session_open(&G.batadv, G.mesh_iface) < 0)
+		exit_errmsg("Invalid mesh interface: %s", G.mesh_iface);
+
+	init_epoll();
+
+	clock_gettime(CLOCK_MONOTONIC, &G.next_invalidation);
+	G.next_invalidation.tv_sec += ORIGINATOR_CACHE_TTL;
+
 	G.stop_daemon = 0;
 	signal(SIGINT, sighandler);
 	signal(SIGTERM, sighandler);
 
 	while (!G.stop_daemon) {
-		FD_ZERO(&rfds);
-		FD_SET(G.sock, &rfds);
-
-		tv.tv_sec = MAX_INTERVAL;
-		tv.tv_usec = 0;
-		retval = select(G.sock + 1, &rfds, NULL, NULL, &tv);
-
-		if (retval < 0) {
+		nevents = epoll_wait(G.epoll_fd, events, ARRAY_SIZE(events), -1);
+		if (nevents < 0) {
 			if (errno != EINTR)
-				exit_errno("select() failed");
-		} else if (retval) {
-			if (FD_ISSET(G.sock, &rfds)) {
-				handle_ra(G.sock);
-			}
+				exit_errno("epoll_wait() failed");
+			continue;
 		}
-		else
-			DEBUG_MSG("select() timeout expired");
-
-		clock_gettime(CLOCK_MONOTONIC, &now);
-		if (G.routers != NULL &&
-		    timespec_diff(&now, &next_update, &diff)) {
-			expire_routers();
-
-			// all routers could have expired, check again
-			if (G.routers != NULL) {
-				if(timespec_diff(&now, &next_invalidation, &diff)) {
-					invalidate_originators();
-
-					next_invalidation = now;
-					next_invalidation.tv_sec += ORIGINATOR_CACHE_TTL;
-				}
 
-				update_tqs();
-				update_ebtables();
-
-				next_update = now;
-				next_update.tv_sec += MIN_INTERVAL;
-			}
+		for (i = 0; i < nevents; i++) {
+			if (events[i].data.fd == G.sock)
+				handle_ra(G.sock);
+			else if (events[i].data.fd == G.timer_fd)
+				handle_timer();
 		}
+
+		update_timer();
 	}
 
 	cleanup();
@@ -0,0 +1,281 @@
+/*
+  Copyright (c) 2016-2019, Matthias Schiffer <mschiffer@universe-factory.net>
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice,
+       this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "respondd-common.h"
+#include "statistics-history.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+static struct proc_file proc_loadavg = PROC_FILE("/proc/loadavg");
+static struct proc_file proc_meminfo = PROC_FILE("/proc/meminfo");
+static struct proc_file proc_stat = PROC_FILE("/proc/stat");
+
+/* The paths are set up in main() for the selected client interface */
+static char rx_bytes_path[64], tx_bytes_path[64];
+static struct proc_file sys_rx_bytes = PROC_FILE(rx_bytes_path);
+static struct proc_file sys_tx_bytes = PROC_FILE(tx_bytes_path);
+
+
+static bool handle_u64(const char *line, void *arg) {
+	uint64_t *value = arg;
+
+	if (!proc_parse_uint(&line, value))
+		*value = 0;
+
+	return false;
+}
+
+static uint64_t read_u64(struct proc_file *file) {
+	uint64_t value = 0;
+
+	proc_read_lines(file, handle_u64, &value);
+	return value;
+}
+
+static bool handle_loadavg(const char *line, void *arg) {
+	struct statistics_history_sample *sample = arg;
+	double loadavg;
+
+	if (proc_parse_decimal(&line, &loadavg))
+		sample->loadavg = loadavg * 100 + 0.5;
+
+	return false;
+}
+
+static bool handle_meminfo(const char *line, void *arg) {
+	struct statistics_history_sample *sample = arg;
+	const char *p = proc_match_key(line, "MemAvailable");
+	uint64_t value;
+
+	if (!p)
+		return true;
+
+	if (proc_parse_uint(&p, &value))
+		sample->memory_available = value;
+
+	return false;
+}
+
+static bool handle_stat(const char *line, void *arg) {
+	struct statistics_history_sample *sample = arg;
+	const char *p = proc_match_key(line, "cpu");
+	/* user, nice, system, idle, iowait, irq, softirq */
+	uint64_t values[7];
+	size_t i;
+
+	if (!p)
+		return true;
+
+	for (i = 0; i < 7; i++) {
+		if (!proc_parse_uint(&p, &values[i]))
+			return false;
+	}
+
+	sample->cpu_busy = values[0] + values[1] + values[2] + values[5] + values[6];
+	sample->cpu_total = sample->cpu_busy + values[3] + values[4];
+
+	return false;
+}
+
+static void sample_clients(struct statistics_history_sample *sample) {
+	const struct wifi_iface *ifaces;
+	size_t n_ifaces = wifi_get_ifaces(&ifaces);
+	size_t i, count;
+
+	for (i = 0; i < n_ifaces; i++) {
+		if (!(ifaces[i].role & WIFI_IFACE_CLIENT))
+			continue;
+
+		if (!wifi_count_stations(&ifaces[i], &count))
+			sample->clients += count;
+	}
+}
+
+static void take_sample(struct statistics_history_sample *sample) {
+	memset(sample, 0, sizeof(*sample));
+
+	sample->time = time(NULL);
+
+	proc_read_lines(&proc_loadavg, handle_loadavg, sample);
+	proc_read_lines(&proc_meminfo, handle_meminfo, sample);
+	proc_read_lines(&proc_stat, handle_stat, sample);
+	sample_clients(sample);
+
+	sample->rx_bytes = read_u64(&sys_rx_bytes);
+	sample->tx_bytes = read_u64(&sys_tx_bytes);
+}
+
+static void store_sample(struct statistics_history *history, const struct statistics_history_sample *sample) {
+	/* Readers retry when seq is odd or has changed during their copy */
+	__atomic_store_n(&history->seq, history->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	history->samples[history->head] = *sample;
+	history->head = (history->head + 1) % STATISTICS_HISTORY_SIZE;
+	if (history->count < STATISTICS_HISTORY_SIZE)
+		history->count++;
+
+	__atomic_store_n(&history->seq, history->seq + 1, __ATOMIC_RELEASE);
+}
+
+static struct statistics_history * map_history(int fd) {
+	struct statistics_history *history;
+
+	history = mmap(NULL, sizeof(*history), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (history == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+
+	return history;
+}
+
+/*
+ * A new file is only renamed into place after it has been sized, so the
+ * respondd provider never maps a file which is shorter than the ring.
+ */
+static struct statistics_history * create_history(void) {
+	const char *tmp_path = STATISTICS_HISTORY_PATH ".tmp";
+	struct statistics_history *history;
+	int fd;
+
+	fd = open(tmp_path, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+	if (fd < 0) {
+		perror("open");
+		return NULL;
+	}
+
+	if (ftruncate(fd, sizeof(*history))) {
+		perror("ftruncate");
+		close(fd);
+		unlink(tmp_path);
+		return NULL;
+	}
+
+	history = map_history(fd);
+	if (!history) {
+		unlink(tmp_path);
+		return NULL;
+	}
+
+	history->version = STATISTICS_HISTORY_VERSION;
+	history->interval = STATISTICS_HISTORY_INTERVAL;
+
+	if (rename(tmp_path, STATISTICS_HISTORY_PATH)) {
+		perror("rename");
+		munmap(history, sizeof(*history));
+		unlink(tmp_path);
+		return NULL;
+	}
+
+	return history;
+}
+
+static struct statistics_history * open_history(void) {
+	struct statistics_history *history;
+	struct stat st;
+	int fd;
+
+	fd = open(STATISTICS_HISTORY_PATH, O_RDWR|O_CLOEXEC);
+	if (fd < 0)
+		return create_history();
+
+	if (fstat(fd, &st) || st.st_size != sizeof(*history)) {
+		close(fd);
+		return create_history();
+	}
+
+	history = map_history(fd);
+	if (!history)
+		return NULL;
+
+	/* The samples of an earlier instance are kept across restarts */
+	if (history->version != STATISTICS_HISTORY_VERSION ||
+	    history->interval != STATISTICS_HISTORY_INTERVAL ||
+	    history->head >= STATISTICS_HISTORY_SIZE ||
+	    history->count > STATISTICS_HISTORY_SIZE || (history->seq & 1)) {
+		munmap(history, sizeof(*history));
+		return create_history();
+	}
+
+	return history;
+}
+
+static void usage(const char *cmd) {
+	fprintf(stderr, "Usage: %s [-i <client interface>]\n", cmd);
+}
+
+int main(int argc, char *argv[]) {
+	struct statistics_history *history;
+	struct statistics_history_sample sample;
+	const char *client_ifname = "br-client";
+	struct timespec next;
+	int c;
+
+	while ((c = getopt(argc, argv, "i:h")) != -1) {
+		switch (c) {
+		case 'i':
+			client_ifname = optarg;
+			break;
+
+		case 'h':
+			usage(argv[0]);
+			return 0;
+
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	snprintf(rx_bytes_path, sizeof(rx_bytes_path), "/sys/class/net/%s/statistics/rx_bytes", client_ifname);
+	snprintf(tx_bytes_path, sizeof(tx_bytes_path), "/sys/class/net/%s/statistics/tx_bytes", client_ifname);
+
+	history = open_history();
+	if (!history)
+		return 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	while (true) {
+		take_sample(&sample);
+		store_sample(history, &sample);
+
+		next.tv_sec += STATISTICS_HISTORY_INTERVAL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {}
+	}
+}
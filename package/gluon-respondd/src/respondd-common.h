@@ -25,8 +25,58 @@
 
 #pragma once
 
+#include <net/if.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
 #define MAX_INACTIVITY 60000
 
+
+enum wifi_iface_role {
+	WIFI_IFACE_CLIENT = (1 << 0),
+	WIFI_IFACE_OWE = (1 << 1),
+	WIFI_IFACE_MESH = (1 << 2),
+};
+
+struct wifi_iface {
+	char ifname[IFNAMSIZ];
+	unsigned role;
+
+	/* 0 if the interface does not exist */
+	unsigned ifindex;
+	/* the interface exists and is a nl80211 interface */
+	bool wireless;
+	/* MHz, 0 if unknown */
+	int frequency;
+};
+
+size_t wifi_get_ifaces(const struct wifi_iface **ifaces);
+int wifi_count_stations(const struct wifi_iface *iface, size_t *count);
+
+
+struct proc_file {
+	const char *path;
+	/* -1 while the file is not open */
+	int fd;
+};
+
+#define PROC_FILE(path) { (path), -1 }
+
+/* Returning false from the callback stops reading the file */
+typedef bool (*proc_line_cb)(const char *line, void *arg);
+
+bool proc_read_lines(struct proc_file *file, proc_line_cb cb, void *arg);
+/* Returns the rest of the line if it starts with the given key, NULL otherwise */
+const char * proc_match_key(const char *line, const char *key);
+bool proc_parse_uint(const char **p, uint64_t *value);
+/* Parses the fixed-point decimals used by /proc/uptime and /proc/loadavg */
+bool proc_parse_decimal(const char **p, double *value);
+
+
 struct json_object * respondd_provider_nodeinfo(void);
 struct json_object * respondd_provider_statistics(void);
+struct json_object * respondd_provider_statistics_history(void);
 struct json_object * respondd_provider_neighbours(void);
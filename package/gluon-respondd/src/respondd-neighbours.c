@@ -30,6 +30,9 @@
 #include <iwinfo.h>
 #include <json-c/json.h>
 
+#include <stdio.h>
+#include <stdlib.h>
+
 
 static struct json_object * get_wifi_neighbours(const char *ifname) {
 	const struct iwinfo_ops *iw = iwinfo_backend(ifname);
@@ -73,46 +76,29 @@ static struct json_object * get_wifi_neighbours(const char *ifname) {
 }
 
 static struct json_object * get_wifi(void) {
-	struct uci_context *ctx = uci_alloc_context();
-	if (!ctx)
-		return NULL;
-
-	ctx->flags &= ~UCI_FLAG_STRICT;
+	const struct wifi_iface *ifaces;
+	size_t n_ifaces = wifi_get_ifaces(&ifaces);
+	size_t i;
 
 	struct json_object *ret = json_object_new_object();
 
-	struct uci_package *p;
-	if (uci_load(ctx, "network", &p))
-		goto end;
-
-
-	struct uci_element *e;
-	uci_foreach_element(&p->sections, e) {
-		struct uci_section *s = uci_to_section(e);
-		if (strcmp(s->type, "interface"))
-			continue;
-
-		const char *proto = uci_lookup_option_string(ctx, s, "proto");
-		if (!proto || strcmp(proto, "gluon_mesh"))
-			continue;
+	for (i = 0; i < n_ifaces; i++) {
+		const struct wifi_iface *iface = &ifaces[i];
 
-		const char *ifname = uci_lookup_option_string(ctx, s, "ifname");
-		if (!ifname)
+		if (!(iface->role & WIFI_IFACE_MESH) || !iface->wireless)
 			continue;
 
-		char *ifaddr = gluonutil_get_interface_address(ifname);
+		char *ifaddr = gluonutil_get_interface_address(iface->ifname);
 		if (!ifaddr)
 			continue;
 
-		struct json_object *neighbours = get_wifi_neighbours(ifname);
+		struct json_object *neighbours = get_wifi_neighbours(iface->ifname);
 		if (neighbours)
 			json_object_object_add(ret, ifaddr, neighbours);
 
 		free(ifaddr);
 	}
 
-end:
-	uci_free_context(ctx);
 	return ret;
 }
 
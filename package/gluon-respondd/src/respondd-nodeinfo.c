@@ -100,7 +100,7 @@ error:
 	return ret;
 }
 
-struct json_object * respondd_provider_nodeinfo(void) {
+static struct json_object * get_nodeinfo(void) {
 	struct json_object *ret = json_object_new_object();
 
 	json_object_object_add(ret, "node_id", gluonutil_wrap_and_free_string(gluonutil_get_node_id()));
@@ -136,3 +136,18 @@ struct json_object * respondd_provider_nodeinfo(void) {
 
 	return ret;
 }
+
+struct json_object * respondd_provider_nodeinfo(void) {
+	static const char *const files[] = {
+		"/etc/config/system",
+		"/etc/config/gluon",
+		"/lib/gluon/site.json",
+		NULL,
+	};
+	static struct gluonutil_json_cache cache = {
+		.ttl = GLUONUTIL_JSON_CACHE_TTL,
+		.files = files,
+	};
+
+	return gluonutil_json_cache_get(&cache, get_nodeinfo);
+}
@@ -0,0 +1,149 @@
+/*
+  Copyright (c) 2016-2019, Matthias Schiffer <mschiffer@universe-factory.net>
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice,
+       this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Line reader for /proc and sysfs files
+ *
+ * The files are kept open and are reread from the start with pread() for
+ * every request. Lines are handled one by one in a fixed buffer; lines
+ * exceeding the buffer (like the "intr" line of /proc/stat on systems with
+ * many interrupts) are truncated, as only their first fields are needed.
+ */
+
+#include "respondd-common.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+
+#define PROC_BUFSIZE 1024
+
+
+static char proc_buf[PROC_BUFSIZE];
+
+bool proc_read_lines(struct proc_file *file, proc_line_cb cb, void *arg) {
+	size_t fill = 0;
+	off_t offset = 0;
+	bool skip = false;
+
+	if (file->fd < 0) {
+		file->fd = open(file->path, O_RDONLY|O_CLOEXEC);
+		if (file->fd < 0)
+			return false;
+	}
+
+	while (true) {
+		ssize_t r = pread(file->fd, proc_buf + fill, sizeof(proc_buf) - 1 - fill, offset);
+		if (r < 0) {
+			close(file->fd);
+			file->fd = -1;
+			return false;
+		}
+
+		offset += r;
+		fill += r;
+
+		char *line = proc_buf, *end;
+		while ((end = memchr(line, '\n', fill - (line - proc_buf)))) {
+			*end = 0;
+			if (!skip && !cb(line, arg))
+				return true;
+
+			skip = false;
+			line = end + 1;
+		}
+
+		fill -= line - proc_buf;
+		memmove(proc_buf, line, fill);
+
+		if (r == 0 || fill == sizeof(proc_buf) - 1) {
+			proc_buf[fill] = 0;
+			if (fill && !skip && !cb(proc_buf, arg))
+				return true;
+			if (r == 0)
+				return true;
+
+			/* Line too long, ignore the rest of it */
+			skip = true;
+			fill = 0;
+		}
+	}
+}
+
+static const char * skip_space(const char *p) {
+	while (*p == ' ' || *p == '\t')
+		p++;
+
+	return p;
+}
+
+const char * proc_match_key(const char *line, const char *key) {
+	size_t len = strlen(key);
+
+	if (strncmp(line, key, len))
+		return NULL;
+
+	if (line[len] != ' ' && line[len] != '\t' && line[len] != ':')
+		return NULL;
+
+	return line + len + 1;
+}
+
+bool proc_parse_uint(const char **p, uint64_t *value) {
+	const char *c = skip_space(*p);
+
+	if (*c < '0' || *c > '9')
+		return false;
+
+	*value = 0;
+	while (*c >= '0' && *c <= '9')
+		*value = *value * 10 + (*c++ - '0');
+
+	*p = c;
+	return true;
+}
+
+bool proc_parse_decimal(const char **p, double *value) {
+	uint64_t integer, fraction = 0;
+	double scale = 1;
+
+	if (!proc_parse_uint(p, &integer))
+		return false;
+
+	if (**p == '.') {
+		const char *c = *p + 1;
+
+		while (*c >= '0' && *c <= '9') {
+			fraction = fraction * 10 + (*c++ - '0');
+			scale *= 10;
+		}
+
+		*p = c;
+	}
+
+	*value = integer + fraction / scale;
+	return true;
+}
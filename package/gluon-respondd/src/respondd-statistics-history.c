@@ -0,0 +1,181 @@
+/*
+  Copyright (c) 2016-2019, Matthias Schiffer <mschiffer@universe-factory.net>
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice,
+       this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * statistics_history provider
+ *
+ * Returns the samples of the ring written by gluon-statistics-history. To
+ * keep the reply small, every counter is returned as an array holding the
+ * value of the oldest sample followed by the differences between consecutive
+ * samples.
+ *
+ * respondd providers can't take arguments, so the whole ring (one hour) is
+ * returned; a collector polling at longer intervals just skips the samples
+ * whose time it has seen before.
+ */
+
+#include "respondd-common.h"
+#include "statistics-history.h"
+
+#include <libgluonutil.h>
+
+#include <json-c/json.h>
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/* Number of attempts to get a consistent copy while a sample is written */
+#define READ_RETRIES 10
+
+
+static const struct statistics_history *history;
+
+struct history_field {
+	const char *name;
+	size_t offset;
+	bool is_64bit;
+};
+
+#define FIELD32(name) { #name, offsetof(struct statistics_history_sample, name), false }
+#define FIELD64(name) { #name, offsetof(struct statistics_history_sample, name), true }
+
+static const struct history_field history_fields[] = {
+	FIELD32(time),
+	FIELD32(loadavg),
+	FIELD32(memory_available),
+	FIELD32(clients),
+	FIELD64(cpu_busy),
+	FIELD64(cpu_total),
+	FIELD64(rx_bytes),
+	FIELD64(tx_bytes),
+};
+
+
+static const struct statistics_history * map_history(void) {
+	if (history)
+		return history;
+
+	int fd = open(STATISTICS_HISTORY_PATH, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	/* Accessing the mapping beyond the end of the file would raise SIGBUS */
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size < (off_t)sizeof(*history)) {
+		close(fd);
+		return NULL;
+	}
+
+	void *p = mmap(NULL, sizeof(*history), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (p == MAP_FAILED)
+		return NULL;
+
+	history = p;
+	return history;
+}
+
+/* Copies the ring in chronological order, returns the number of samples */
+static size_t read_samples(struct statistics_history_sample *samples, uint32_t *interval) {
+	const struct statistics_history *h = map_history();
+	size_t i, j;
+
+	if (!h)
+		return 0;
+
+	for (i = 0; i < READ_RETRIES; i++) {
+		uint32_t seq = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+
+		uint32_t head = h->head, count = h->count;
+		if (h->version != STATISTICS_HISTORY_VERSION || head >= STATISTICS_HISTORY_SIZE ||
+		    count > STATISTICS_HISTORY_SIZE)
+			return 0;
+
+		*interval = h->interval;
+
+		for (j = 0; j < count; j++)
+			samples[j] = h->samples[(head + STATISTICS_HISTORY_SIZE - count + j) % STATISTICS_HISTORY_SIZE];
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&h->seq, __ATOMIC_RELAXED) == seq)
+			return count;
+	}
+
+	return 0;
+}
+
+static int64_t get_field(const struct statistics_history_sample *sample, const struct history_field *field) {
+	const char *p = (const char *)sample + field->offset;
+
+	if (field->is_64bit)
+		return *(const uint64_t *)p;
+	else
+		return *(const uint32_t *)p;
+}
+
+static struct json_object * get_deltas(const struct statistics_history_sample *samples, size_t count,
+				       const struct history_field *field) {
+	struct json_object *ret = json_object_new_array();
+	int64_t last = 0;
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		int64_t value = get_field(&samples[i], field);
+		json_object_array_add(ret, json_object_new_int64(value - last));
+		last = value;
+	}
+
+	return ret;
+}
+
+struct json_object * respondd_provider_statistics_history(void) {
+	struct statistics_history_sample samples[STATISTICS_HISTORY_SIZE];
+	uint32_t interval;
+	size_t count, i;
+
+	count = read_samples(samples, &interval);
+	if (!count)
+		return NULL;
+
+	struct json_object *ret = json_object_new_object();
+
+	json_object_object_add(ret, "node_id", gluonutil_wrap_and_free_string(gluonutil_get_node_id()));
+	json_object_object_add(ret, "interval", json_object_new_int(interval));
+
+	for (i = 0; i < sizeof(history_fields) / sizeof(history_fields[0]); i++)
+		json_object_object_add(ret, history_fields[i].name,
+				       get_deltas(samples, count, &history_fields[i]));
+
+	return ret;
+}
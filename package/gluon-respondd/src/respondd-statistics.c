@@ -27,10 +27,10 @@
 
 #include <libgluonutil.h>
 
-#include <iwinfo.h>
 #include <json-c/json.h>
 
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -38,154 +38,177 @@
 #include <sys/vfs.h>
 
 
-static void add_uptime(struct json_object *obj) {
-	FILE *f = fopen("/proc/uptime", "r");
-	struct json_object* jso;
-	if (!f)
-		return;
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+
+static struct proc_file proc_uptime = PROC_FILE("/proc/uptime");
+static struct proc_file proc_loadavg = PROC_FILE("/proc/loadavg");
+static struct proc_file proc_meminfo = PROC_FILE("/proc/meminfo");
+static struct proc_file proc_stat = PROC_FILE("/proc/stat");
+
 
+static struct json_object * new_double(double value, const char *format) {
+	struct json_object *jso = json_object_new_double(value);
+	json_object_set_serializer(jso, json_object_double_to_json_string, (void *)format, NULL);
+	return jso;
+}
+
+static bool handle_uptime(const char *line, void *arg) {
+	struct json_object *obj = arg;
 	double uptime, idletime;
-	if (fscanf(f, "%lf %lf", &uptime, &idletime) == 2) {
-		jso = json_object_new_double(uptime);
-		json_object_set_serializer(jso, json_object_double_to_json_string, "%.2f", NULL);
-		json_object_object_add(obj, "uptime", jso);
-		jso = json_object_new_double(idletime);
-		json_object_set_serializer(jso, json_object_double_to_json_string, "%.2f", NULL);
-		json_object_object_add(obj, "idletime", jso);
-	}
 
-	fclose(f);
+	if (!proc_parse_decimal(&line, &uptime) || !proc_parse_decimal(&line, &idletime))
+		return false;
+
+	json_object_object_add(obj, "uptime", new_double(uptime, "%.2f"));
+	json_object_object_add(obj, "idletime", new_double(idletime, "%.2f"));
+
+	return false;
 }
 
-static void add_loadavg(struct json_object *obj) {
-	FILE *f = fopen("/proc/loadavg", "r");
-	if (!f)
-		return;
-
-	double loadavg;
-	unsigned proc_running, proc_total;
-	if (fscanf(f, "%lf %*f %*f %u/%u", &loadavg, &proc_running, &proc_total) == 3) {
-		struct json_object *jso = json_object_new_double(loadavg);
-		json_object_set_serializer(jso, json_object_double_to_json_string, "%.2f", NULL);
-		json_object_object_add(obj, "loadavg", jso);
-
-		struct json_object *processes = json_object_new_object();
-		json_object_object_add(processes, "running", json_object_new_int(proc_running));
-		json_object_object_add(processes, "total", json_object_new_int(proc_total));
-		json_object_object_add(obj, "processes", processes);
-	}
+static void add_uptime(struct json_object *obj) {
+	proc_read_lines(&proc_uptime, handle_uptime, obj);
+}
+
+static bool handle_loadavg(const char *line, void *arg) {
+	struct json_object *obj = arg;
+	double loadavg, ignore;
+	uint64_t proc_running, proc_total;
 
-	fclose(f);
+	if (!proc_parse_decimal(&line, &loadavg) ||
+	    !proc_parse_decimal(&line, &ignore) || !proc_parse_decimal(&line, &ignore) ||
+	    !proc_parse_uint(&line, &proc_running) || *line++ != '/' ||
+	    !proc_parse_uint(&line, &proc_total))
+		return false;
+
+	json_object_object_add(obj, "loadavg", new_double(loadavg, "%.2f"));
+
+	struct json_object *processes = json_object_new_object();
+	json_object_object_add(processes, "running", json_object_new_int(proc_running));
+	json_object_object_add(processes, "total", json_object_new_int(proc_total));
+	json_object_object_add(obj, "processes", processes);
+
+	return false;
 }
 
-static struct json_object * get_memory(void) {
-	FILE *f = fopen("/proc/meminfo", "r");
-	if (!f)
-		return NULL;
+static void add_loadavg(struct json_object *obj) {
+	proc_read_lines(&proc_loadavg, handle_loadavg, obj);
+}
 
-	struct json_object *ret = json_object_new_object();
+static const char *const meminfo_keys[][2] = {
+	{ "MemTotal", "total" },
+	{ "MemFree", "free" },
+	{ "MemAvailable", "available" },
+	{ "Buffers", "buffers" },
+	{ "Cached", "cached" },
+};
 
-	char *line = NULL;
-	size_t len = 0;
+static bool handle_meminfo(const char *line, void *arg) {
+	struct json_object *obj = arg;
+	size_t i;
 
-	while (getline(&line, &len, f) >= 0) {
-		char label[32];
-		unsigned value;
+	for (i = 0; i < ARRAY_SIZE(meminfo_keys); i++) {
+		const char *p = proc_match_key(line, meminfo_keys[i][0]);
+		uint64_t value;
 
-		if (sscanf(line, "%31[^:]: %u", label, &value) != 2)
+		if (!p)
 			continue;
 
-		if (!strcmp(label, "MemTotal"))
-			json_object_object_add(ret, "total", json_object_new_int(value));
-		else if (!strcmp(label, "MemFree"))
-			json_object_object_add(ret, "free", json_object_new_int(value));
-		else if (!strcmp(label, "MemAvailable"))
-			json_object_object_add(ret, "available", json_object_new_int(value));
-		else if (!strcmp(label, "Buffers"))
-			json_object_object_add(ret, "buffers", json_object_new_int(value));
-		else if (!strcmp(label, "Cached"))
-			json_object_object_add(ret, "cached", json_object_new_int(value));
-	}
+		if (proc_parse_uint(&p, &value))
+			json_object_object_add(obj, meminfo_keys[i][1], json_object_new_int(value));
 
-	free(line);
-	fclose(f);
+		break;
+	}
 
-	return ret;
+	return true;
 }
 
-static struct json_object * get_stat(void) {
-	FILE *f = fopen("/proc/stat", "r");
-	if (!f)
+static struct json_object * get_memory(void) {
+	struct json_object *ret = json_object_new_object();
+
+	if (!proc_read_lines(&proc_meminfo, handle_meminfo, ret)) {
+		json_object_put(ret);
 		return NULL;
+	}
 
-	struct json_object *stat = json_object_new_object();
-	struct json_object *ret = NULL;
+	return ret;
+}
 
-	char *line = NULL;
-	size_t len = 0;
+static const char *const stat_keys[] = {
+	"ctxt",
+	"intr",
+	"softirq",
+	"processes",
+};
+
+static const char *const stat_cpu_keys[] = {
+	"user",
+	"nice",
+	"system",
+	"idle",
+	"iowait",
+	"irq",
+	"softirq",
+};
+
+struct stat_ctx {
+	struct json_object *stat;
+	bool valid;
+};
+
+static bool handle_stat(const char *line, void *arg) {
+	struct stat_ctx *ctx = arg;
+	const char *p;
+	uint64_t value;
+	size_t i;
+
+	if ((p = proc_match_key(line, "cpu"))) {
+		uint64_t values[ARRAY_SIZE(stat_cpu_keys)];
+
+		for (i = 0; i < ARRAY_SIZE(stat_cpu_keys); i++) {
+			if (!proc_parse_uint(&p, &values[i]))
+				goto invalid;
+		}
 
-	while (getline(&line, &len, f) >= 0) {
-		char label[32];
+		struct json_object *cpu = json_object_new_object();
+		for (i = 0; i < ARRAY_SIZE(stat_cpu_keys); i++)
+			json_object_object_add(cpu, stat_cpu_keys[i], json_object_new_int64(values[i]));
 
-		if (sscanf(line, "%31s", label) != 1){
-			goto invalid_stat_format;
-		}
+		json_object_object_add(ctx->stat, "cpu", cpu);
+		return true;
+	}
 
-		if (!strcmp(label, "cpu")) {
-			int64_t user, nice, system, idle, iowait, irq, softirq;
-			if (sscanf(line, "%*s %"SCNd64" %"SCNd64" %"SCNd64" %"SCNd64" %"SCNd64" %"SCNd64" %"SCNd64,
-			          &user, &nice, &system, &idle, &iowait, &irq, &softirq) != 7)
-				goto invalid_stat_format;
-
-			struct json_object *cpu = json_object_new_object();
-
-			json_object_object_add(cpu, "user", json_object_new_int64(user));
-			json_object_object_add(cpu, "nice", json_object_new_int64(nice));
-			json_object_object_add(cpu, "system", json_object_new_int64(system));
-			json_object_object_add(cpu, "idle", json_object_new_int64(idle));
-			json_object_object_add(cpu, "iowait", json_object_new_int64(iowait));
-			json_object_object_add(cpu, "irq", json_object_new_int64(irq));
-			json_object_object_add(cpu, "softirq", json_object_new_int64(softirq));
-
-			json_object_object_add(stat, "cpu", cpu);
-		} else if (!strcmp(label, "ctxt")) {
-			int64_t ctxt;
-			if (sscanf(line, "%*s %"SCNd64, &ctxt) != 1)
-				goto invalid_stat_format;
-
-			json_object_object_add(stat, "ctxt", json_object_new_int64(ctxt));
-		} else if (!strcmp(label, "intr")) {
-			int64_t total_intr;
-			if (sscanf(line, "%*s %"SCNd64, &total_intr) != 1)
-				goto invalid_stat_format;
-
-			json_object_object_add(stat, "intr", json_object_new_int64(total_intr));
-		} else if (!strcmp(label, "softirq")) {
-			int64_t total_softirq;
-			if (sscanf(line, "%*s %"SCNd64, &total_softirq) != 1)
-				goto invalid_stat_format;
-
-			json_object_object_add(stat, "softirq", json_object_new_int64(total_softirq));
-		} else if (!strcmp(label, "processes")) {
-			int64_t processes;
-			if (sscanf(line, "%*s %"SCNd64, &processes) != 1)
-				goto invalid_stat_format;
-
-			json_object_object_add(stat, "processes", json_object_new_int64(processes));
-		}
+	for (i = 0; i < ARRAY_SIZE(stat_keys); i++) {
+		p = proc_match_key(line, stat_keys[i]);
+		if (!p)
+			continue;
 
+		if (!proc_parse_uint(&p, &value))
+			goto invalid;
+
+		json_object_object_add(ctx->stat, stat_keys[i], json_object_new_int64(value));
+		break;
 	}
 
-	ret = stat;
+	return true;
 
-invalid_stat_format:
-	if (!ret)
-		json_object_put(stat);
+invalid:
+	ctx->valid = false;
+	return false;
+}
 
-	free(line);
-	fclose(f);
+static struct json_object * get_stat(void) {
+	struct stat_ctx ctx = {
+		.stat = json_object_new_object(),
+		.valid = true,
+	};
 
-	return ret;
+	if (!proc_read_lines(&proc_stat, handle_stat, &ctx) || !ctx.valid) {
+		json_object_put(ctx.stat);
+		return NULL;
+	}
+
+	return ctx.stat;
 }
 
 
@@ -208,75 +231,35 @@ static struct json_object * get_time(void) {
 	return json_object_new_int64(now.tv_sec);
 }
 
-static void count_iface_stations(size_t *wifi24, size_t *wifi5, const char *ifname) {
-	const struct iwinfo_ops *iw = iwinfo_backend(ifname);
-	if (!iw)
-		return;
-
-	int freq;
-	if (iw->frequency(ifname, &freq) < 0)
-		return;
-
-	size_t *wifi;
-	if (freq >= 2400 && freq < 2500)
-		wifi = wifi24;
-	else if (freq >= 5000 && freq < 6000)
-		wifi = wifi5;
-	else
-		return;
-
-	int len;
-	char buf[IWINFO_BUFSIZE];
-	if (iw->assoclist(ifname, buf, &len) < 0)
-		return;
-
-	struct iwinfo_assoclist_entry *entry;
-	for (entry = (struct iwinfo_assoclist_entry *)buf; (char*)(entry+1) <= buf + len; entry++) {
-		if (entry->inactive > MAX_INACTIVITY)
-			continue;
-
-		(*wifi)++;
-	}
-}
-
-static void count_stations(size_t *wifi24, size_t *wifi5, size_t *owe24, size_t owe5) {
-	struct uci_context *ctx = uci_alloc_context();
-	if (!ctx)
-		return;
-	ctx->flags &= ~UCI_FLAG_STRICT;
+static void count_stations(size_t *wifi24, size_t *wifi5, size_t *owe24, size_t *owe5) {
+	const struct wifi_iface *ifaces;
+	size_t n_ifaces = wifi_get_ifaces(&ifaces);
+	size_t i;
 
+	for (i = 0; i < n_ifaces; i++) {
+		const struct wifi_iface *iface = &ifaces[i];
+		size_t *wifi, *owe, count;
 
-	struct uci_package *p;
-	if (uci_load(ctx, "wireless", &p))
-		goto end;
-
-
-	struct uci_element *e;
-	uci_foreach_element(&p->sections, e) {
-		struct uci_section *s = uci_to_section(e);
-		if (strcmp(s->type, "wifi-iface"))
-			continue;
-
-		const char *network = uci_lookup_option_string(ctx, s, "network");
-		if (!network || strcmp(network, "client"))
+		if (!(iface->role & WIFI_IFACE_CLIENT))
 			continue;
 
-		const char *mode = uci_lookup_option_string(ctx, s, "mode");
-		if (!mode || strcmp(mode, "ap"))
+		if (iface->frequency >= 2400 && iface->frequency < 2500) {
+			wifi = wifi24;
+			owe = owe24;
+		} else if (iface->frequency >= 5000 && iface->frequency < 6000) {
+			wifi = wifi5;
+			owe = owe5;
+		} else {
 			continue;
+		}
 
-		const char *ifname = uci_lookup_option_string(ctx, s, "ifname");
-		if (!ifname)
+		if (wifi_count_stations(iface, &count))
 			continue;
 
-		if (strstr(ifname, "owe") == ifname)
-			count_iface_stations(owe24, owe5, ifname);
-
-		count_iface_stations(wifi24, wifi5, ifname);
+		*wifi += count;
+		if (iface->role & WIFI_IFACE_OWE)
+			*owe += count;
 	}
-
- end:
-	uci_free_context(ctx);
 }
 
 static struct json_object * get_clients(void) {
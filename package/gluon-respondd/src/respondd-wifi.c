@@ -0,0 +1,476 @@
+/*
+  Copyright (c) 2016-2019, Matthias Schiffer <mschiffer@universe-factory.net>
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice,
+       this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Registry of the client and mesh wifi interfaces
+ *
+ * The interface names are taken from the UCI configuration, which is only
+ * reloaded when the wireless or network config file has changed. The kernel
+ * state of the interfaces (ifindex and frequency) is cached as well and
+ * refreshed when rtnetlink reports a link change of one of them, so a
+ * request only costs two stat() calls and a non-blocking read in the common
+ * case.
+ */
+
+#include "respondd-common.h"
+
+#include <uci.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+#include <linux/rtnetlink.h>
+
+#include <netlink/genl/ctrl.h>
+#include <netlink/genl/genl.h>
+
+
+struct wifi_registry {
+	struct wifi_iface *ifaces;
+	size_t n_ifaces;
+
+	struct timespec wireless_mtime;
+	struct timespec network_mtime;
+
+	/* rtnetlink socket subscribed to link changes */
+	int rtnl_fd;
+	/* the kernel state of the interfaces must be refreshed */
+	bool stale;
+
+	struct nl_sock *nl80211;
+	int nl80211_id;
+};
+
+static struct wifi_registry registry = {
+	.rtnl_fd = -1,
+	.nl80211_id = -1,
+};
+
+struct nl80211_query {
+	nl_recvmsg_msg_cb_t callback;
+	void *arg;
+	int err;
+	bool done;
+};
+
+
+static bool update_mtime(struct timespec *mtime, const char *path) {
+	struct stat st;
+
+	if (stat(path, &st))
+		memset(&st, 0, sizeof(st));
+
+	if (st.st_mtim.tv_sec == mtime->tv_sec && st.st_mtim.tv_nsec == mtime->tv_nsec)
+		return false;
+
+	*mtime = st.st_mtim;
+	return true;
+}
+
+static struct wifi_iface * registry_add(const char *ifname, unsigned role) {
+	size_t i;
+
+	for (i = 0; i < registry.n_ifaces; i++) {
+		if (!strcmp(registry.ifaces[i].ifname, ifname)) {
+			registry.ifaces[i].role |= role;
+			return &registry.ifaces[i];
+		}
+	}
+
+	if (strlen(ifname) >= IFNAMSIZ)
+		return NULL;
+
+	struct wifi_iface *ifaces = realloc(registry.ifaces, (registry.n_ifaces + 1) * sizeof(*ifaces));
+	if (!ifaces)
+		return NULL;
+
+	registry.ifaces = ifaces;
+
+	struct wifi_iface *iface = &registry.ifaces[registry.n_ifaces++];
+	memset(iface, 0, sizeof(*iface));
+	strcpy(iface->ifname, ifname);
+	iface->role = role;
+
+	return iface;
+}
+
+static void load_wireless(struct uci_context *ctx) {
+	struct uci_package *p;
+	if (uci_load(ctx, "wireless", &p))
+		return;
+
+	struct uci_element *e;
+	uci_foreach_element(&p->sections, e) {
+		struct uci_section *s = uci_to_section(e);
+		if (strcmp(s->type, "wifi-iface"))
+			continue;
+
+		const char *network = uci_lookup_option_string(ctx, s, "network");
+		if (!network || strcmp(network, "client"))
+			continue;
+
+		const char *mode = uci_lookup_option_string(ctx, s, "mode");
+		if (!mode || strcmp(mode, "ap"))
+			continue;
+
+		const char *ifname = uci_lookup_option_string(ctx, s, "ifname");
+		if (!ifname)
+			continue;
+
+		unsigned role = WIFI_IFACE_CLIENT;
+		if (strstr(ifname, "owe") == ifname)
+			role |= WIFI_IFACE_OWE;
+
+		registry_add(ifname, role);
+	}
+}
+
+static void load_network(struct uci_context *ctx) {
+	struct uci_package *p;
+	if (uci_load(ctx, "network", &p))
+		return;
+
+	struct uci_element *e;
+	uci_foreach_element(&p->sections, e) {
+		struct uci_section *s = uci_to_section(e);
+		if (strcmp(s->type, "interface"))
+			continue;
+
+		const char *proto = uci_lookup_option_string(ctx, s, "proto");
+		if (!proto || strcmp(proto, "gluon_mesh"))
+			continue;
+
+		const char *ifname = uci_lookup_option_string(ctx, s, "ifname");
+		if (!ifname)
+			continue;
+
+		registry_add(ifname, WIFI_IFACE_MESH);
+	}
+}
+
+static void load_config(void) {
+	free(registry.ifaces);
+	registry.ifaces = NULL;
+	registry.n_ifaces = 0;
+	registry.stale = true;
+
+	struct uci_context *ctx = uci_alloc_context();
+	if (!ctx)
+		return;
+	ctx->flags &= ~UCI_FLAG_STRICT;
+
+	load_wireless(ctx);
+	load_network(ctx);
+
+	uci_free_context(ctx);
+}
+
+static void rtnl_open(void) {
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = RTMGRP_LINK,
+	};
+
+	registry.rtnl_fd = socket(AF_NETLINK, SOCK_RAW|SOCK_NONBLOCK|SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (registry.rtnl_fd < 0)
+		return;
+
+	if (bind(registry.rtnl_fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		close(registry.rtnl_fd);
+		registry.rtnl_fd = -1;
+	}
+}
+
+static bool is_registered(const char *ifname) {
+	size_t i;
+
+	for (i = 0; i < registry.n_ifaces; i++) {
+		if (!strcmp(registry.ifaces[i].ifname, ifname))
+			return true;
+	}
+
+	return false;
+}
+
+static void handle_link_msg(const struct nlmsghdr *nh) {
+	if (nh->nlmsg_type != RTM_NEWLINK && nh->nlmsg_type != RTM_DELLINK)
+		return;
+
+	const struct ifinfomsg *ifi = NLMSG_DATA(nh);
+	const struct rtattr *rta = IFLA_RTA(ifi);
+	int len = IFLA_PAYLOAD(nh);
+
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type != IFLA_IFNAME)
+			continue;
+
+		if (is_registered(RTA_DATA(rta)))
+			registry.stale = true;
+
+		return;
+	}
+}
+
+/* Reads the pending link change notifications without blocking */
+static void rtnl_process(void) {
+	char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+	if (registry.rtnl_fd < 0) {
+		rtnl_open();
+
+		/* Changes before the subscription are unknown */
+		registry.stale = true;
+		if (registry.rtnl_fd < 0)
+			return;
+	}
+
+	while (true) {
+		ssize_t len = recv(registry.rtnl_fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+
+			/* ENOBUFS: notifications were lost */
+			registry.stale = true;
+			if (errno != ENOBUFS) {
+				close(registry.rtnl_fd);
+				registry.rtnl_fd = -1;
+				return;
+			}
+
+			continue;
+		}
+
+		const struct nlmsghdr *nh;
+		for (nh = (const struct nlmsghdr *)buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+			handle_link_msg(nh);
+	}
+}
+
+static void nl80211_disconnect(void) {
+	if (!registry.nl80211)
+		return;
+
+	nl_socket_free(registry.nl80211);
+	registry.nl80211 = NULL;
+}
+
+static int nl80211_connect(void) {
+	if (!registry.nl80211) {
+		registry.nl80211 = nl_socket_alloc();
+		if (!registry.nl80211)
+			return -ENOMEM;
+
+		if (genl_connect(registry.nl80211)) {
+			nl80211_disconnect();
+			return -ENOTCONN;
+		}
+
+		registry.nl80211_id = -1;
+	}
+
+	if (registry.nl80211_id < 0) {
+		registry.nl80211_id = genl_ctrl_resolve(registry.nl80211, NL80211_GENL_NAME);
+		if (registry.nl80211_id < 0)
+			return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+static int nl80211_valid_cb(struct nl_msg *msg, void *arg) {
+	struct nl80211_query *query = arg;
+
+	return query->callback(msg, query->arg);
+}
+
+static int nl80211_finish_cb(struct nl_msg *msg, void *arg) {
+	struct nl80211_query *query = arg;
+
+	query->done = true;
+	return NL_STOP;
+}
+
+static int nl80211_error_cb(struct sockaddr_nl *nla, struct nlmsgerr *nlerr, void *arg) {
+	struct nl80211_query *query = arg;
+
+	query->err = nlerr->error;
+	query->done = true;
+	return NL_STOP;
+}
+
+/* Runs a nl80211 dump, optionally restricted to the interface ifindex */
+static int nl80211_dump(uint8_t cmd, unsigned ifindex, nl_recvmsg_msg_cb_t callback, void *arg) {
+	struct nl80211_query query = {
+		.callback = callback,
+		.arg = arg,
+	};
+	struct nl_msg *msg = NULL;
+	struct nl_cb *cb = NULL;
+	int ret;
+
+	ret = nl80211_connect();
+	if (ret)
+		return ret;
+
+	cb = nl_cb_alloc(NL_CB_DEFAULT);
+	msg = nlmsg_alloc();
+	if (!cb || !msg) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, nl80211_valid_cb, &query);
+	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, nl80211_finish_cb, &query);
+	nl_cb_err(cb, NL_CB_CUSTOM, nl80211_error_cb, &query);
+
+	genlmsg_put(msg, NL_AUTO_PID, NL_AUTO_SEQ, registry.nl80211_id, 0, NLM_F_DUMP, cmd, 0);
+	if (ifindex)
+		nla_put_u32(msg, NL80211_ATTR_IFINDEX, ifindex);
+
+	ret = nl_send_auto_complete(registry.nl80211, msg);
+	if (ret >= 0)
+		ret = nl_recvmsgs(registry.nl80211, cb);
+
+	if (query.err)
+		ret = query.err;
+	else if (ret > 0)
+		ret = 0;
+
+out:
+	/* Unread replies would confuse the next dump */
+	if (!query.done)
+		nl80211_disconnect();
+
+	nlmsg_free(msg);
+	nl_cb_put(cb);
+
+	return ret;
+}
+
+static int parse_interface(struct nl_msg *msg, void *arg) {
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	size_t i;
+
+	if (nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0), NULL))
+		return NL_SKIP;
+
+	if (!tb[NL80211_ATTR_IFINDEX])
+		return NL_SKIP;
+
+	unsigned ifindex = nla_get_u32(tb[NL80211_ATTR_IFINDEX]);
+
+	for (i = 0; i < registry.n_ifaces; i++) {
+		struct wifi_iface *iface = &registry.ifaces[i];
+		if (iface->ifindex != ifindex)
+			continue;
+
+		iface->wireless = true;
+		if (tb[NL80211_ATTR_WIPHY_FREQ])
+			iface->frequency = nla_get_u32(tb[NL80211_ATTR_WIPHY_FREQ]);
+	}
+
+	return NL_OK;
+}
+
+static void refresh_ifaces(void) {
+	size_t i;
+
+	for (i = 0; i < registry.n_ifaces; i++) {
+		struct wifi_iface *iface = &registry.ifaces[i];
+
+		iface->ifindex = if_nametoindex(iface->ifname);
+		iface->wireless = false;
+		iface->frequency = 0;
+	}
+
+	/* On failure, the registry is refreshed again by the next request */
+	registry.stale = nl80211_dump(NL80211_CMD_GET_INTERFACE, 0, parse_interface, NULL) != 0;
+}
+
+size_t wifi_get_ifaces(const struct wifi_iface **ifaces) {
+	bool wireless_changed = update_mtime(&registry.wireless_mtime, "/etc/config/wireless");
+	bool network_changed = update_mtime(&registry.network_mtime, "/etc/config/network");
+
+	if (wireless_changed || network_changed)
+		load_config();
+
+	rtnl_process();
+
+	if (registry.stale)
+		refresh_ifaces();
+
+	*ifaces = registry.ifaces;
+	return registry.n_ifaces;
+}
+
+static int count_station(struct nl_msg *msg, void *arg) {
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct nlattr *sinfo[NL80211_STA_INFO_MAX + 1];
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	size_t *count = arg;
+
+	if (nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0), NULL))
+		return NL_SKIP;
+
+	if (!tb[NL80211_ATTR_STA_INFO])
+		return NL_SKIP;
+
+	if (nla_parse_nested(sinfo, NL80211_STA_INFO_MAX, tb[NL80211_ATTR_STA_INFO], NULL))
+		return NL_SKIP;
+
+	if (sinfo[NL80211_STA_INFO_INACTIVE_TIME] &&
+	    nla_get_u32(sinfo[NL80211_STA_INFO_INACTIVE_TIME]) > MAX_INACTIVITY)
+		return NL_SKIP;
+
+	(*count)++;
+	return NL_OK;
+}
+
+/* Counts the stations of an interface which were active recently */
+int wifi_count_stations(const struct wifi_iface *iface, size_t *count) {
+	size_t n = 0;
+	int ret;
+
+	if (!iface->ifindex || !iface->wireless)
+		return -ENODEV;
+
+	ret = nl80211_dump(NL80211_CMD_GET_STATION, iface->ifindex, count_station, &n);
+	if (ret)
+		return ret;
+
+	*count = n;
+	return 0;
+}
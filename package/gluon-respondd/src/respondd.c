@@ -32,6 +32,7 @@ __attribute__ ((visibility ("default")))
 const struct respondd_provider_info respondd_providers[] = {
 	{"nodeinfo", respondd_provider_nodeinfo},
 	{"statistics", respondd_provider_statistics},
+	{"statistics_history", respondd_provider_statistics_history},
 	{"neighbours", respondd_provider_neighbours},
 	{}
 };
@@ -0,0 +1,77 @@
+/*
+  Copyright (c) 2016-2019, Matthias Schiffer <mschiffer@universe-factory.net>
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice,
+       this list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+/*
+ * Ring of statistics samples shared between gluon-statistics-history, which
+ * takes a sample every STATISTICS_HISTORY_INTERVAL seconds, and the
+ * statistics_history respondd provider. The ring lives in a file on tmpfs,
+ * which is mapped by both processes.
+ */
+
+#include <stdint.h>
+
+
+#define STATISTICS_HISTORY_PATH "/var/run/gluon-statistics-history"
+#define STATISTICS_HISTORY_VERSION 1
+
+#define STATISTICS_HISTORY_INTERVAL 60
+/* One hour of samples */
+#define STATISTICS_HISTORY_SIZE 60
+
+
+struct statistics_history_sample {
+	/* UNIX time of the sample */
+	uint32_t time;
+	/* 1 minute load average, multiplied by 100 */
+	uint32_t loadavg;
+	/* MemAvailable in kB */
+	uint32_t memory_available;
+	/* wifi clients of the client network */
+	uint32_t clients;
+
+	/* jiffies of all CPUs, busy and in total */
+	uint64_t cpu_busy;
+	uint64_t cpu_total;
+
+	/* bytes transferred on the client bridge */
+	uint64_t rx_bytes;
+	uint64_t tx_bytes;
+};
+
+struct statistics_history {
+	uint32_t version;
+	/* odd while a sample is written */
+	uint32_t seq;
+
+	uint32_t interval;
+	/* index of the next sample to write */
+	uint32_t head;
+	/* number of valid samples */
+	uint32_t count;
+
+	struct statistics_history_sample samples[STATISTICS_HISTORY_SIZE];
+};
@@ -1,5 +1,18 @@
+/*
+ * Streams the batman-adv neighbours to the status page. The originator table
+ * is dumped over one netlink session and compared with the state last sent:
+ * Each event only contains new neighbours and those whose TQ changed by at
+ * least TQ_THRESHOLD (or whose interface or best flag changed), removed
+ * neighbours are mapped to null. All neighbours are sent every
+ * KEYFRAME_INTERVAL. The polling interval drops to POLL_MIN after a change
+ * and doubles up to POLL_MAX while nothing changes.
+ */
+
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <json-c/json.h>
 #include <net/if.h>
@@ -9,55 +22,71 @@
 #define STR(x) #x
 #define XSTR(x) STR(x)
 
+#define POLL_MIN 1 /* s */
+#define POLL_MAX 10 /* s */
+/* viewers joining a shared stream wait at most this long for all neighbours */
+#define KEYFRAME_INTERVAL POLL_MAX
+#define TQ_THRESHOLD 3 /* percent */
+#define MAX_NEIGHBOURS 256
+
+struct neighbour {
+  uint8_t addr[6];
+  uint8_t tq;
+  bool best;
+  char ifname[IF_NAMESIZE];
+};
+
+struct neighbour_list {
+  struct neighbour neighbours[MAX_NEIGHBOURS];
+  size_t len;
+};
+
 struct neigh_netlink_opts {
-  struct json_object *obj;
+  struct neighbour_list *list;
   struct batadv_nlquery_opts query_opts;
 };
 
-static const enum batadv_nl_attrs parse_orig_list_mandatory[] = {
-  BATADV_ATTR_ORIG_ADDRESS,
-  BATADV_ATTR_NEIGH_ADDRESS,
-  BATADV_ATTR_TQ,
-  BATADV_ATTR_HARD_IFINDEX,
-  BATADV_ATTR_LAST_SEEN_MSECS,
+enum {
+  ORIG_LIST_ATTR_ORIG_ADDRESS,
+  ORIG_LIST_ATTR_NEIGH_ADDRESS,
+  ORIG_LIST_ATTR_TQ,
+  ORIG_LIST_ATTR_HARD_IFINDEX,
+  ORIG_LIST_ATTR_LAST_SEEN_MSECS,
+  ORIG_LIST_ATTR_FLAG_BEST,
+  ORIG_LIST_ATTR_NUM,
+};
+
+static const struct batadv_genl_attr_spec parse_orig_list_attrs[ORIG_LIST_ATTR_NUM] = {
+  [ORIG_LIST_ATTR_ORIG_ADDRESS] = { BATADV_ATTR_ORIG_ADDRESS, true },
+  [ORIG_LIST_ATTR_NEIGH_ADDRESS] = { BATADV_ATTR_NEIGH_ADDRESS, true },
+  [ORIG_LIST_ATTR_TQ] = { BATADV_ATTR_TQ, true },
+  [ORIG_LIST_ATTR_HARD_IFINDEX] = { BATADV_ATTR_HARD_IFINDEX, true },
+  [ORIG_LIST_ATTR_LAST_SEEN_MSECS] = { BATADV_ATTR_LAST_SEEN_MSECS, true },
+  [ORIG_LIST_ATTR_FLAG_BEST] = { BATADV_ATTR_FLAG_BEST, false },
 };
 
 static int parse_orig_list_netlink_cb(struct nl_msg *msg, void *arg)
 {
-  struct nlattr *attrs[BATADV_ATTR_MAX+1];
-  struct nlmsghdr *nlh = nlmsg_hdr(msg);
+  struct nlattr *attrs[ORIG_LIST_ATTR_NUM];
   struct batadv_nlquery_opts *query_opts = arg;
-  struct genlmsghdr *ghdr;
   uint8_t *orig;
   uint8_t *dest;
   uint8_t tq;
   uint32_t hardif;
   char ifname_buf[IF_NAMESIZE], *ifname;
   struct neigh_netlink_opts *opts;
-  char mac1[18];
+  struct neighbour *neigh;
 
   opts = batadv_container_of(query_opts, struct neigh_netlink_opts, query_opts);
 
-  if (!genlmsg_valid_hdr(nlh, 0))
-    return NL_OK;
-
-  ghdr = nlmsg_data(nlh);
-
-  if (ghdr->cmd != BATADV_CMD_GET_ORIGINATORS)
+  if (batadv_genl_parse(msg, BATADV_CMD_GET_ORIGINATORS,
+                        parse_orig_list_attrs, attrs, ORIG_LIST_ATTR_NUM))
     return NL_OK;
 
-  if (nla_parse(attrs, BATADV_ATTR_MAX, genlmsg_attrdata(ghdr, 0),
-        genlmsg_len(ghdr), batadv_genl_policy))
-    return NL_OK;
-
-  if (batadv_genl_missing_attrs(attrs, parse_orig_list_mandatory,
-	                        BATADV_ARRAY_SIZE(parse_orig_list_mandatory)))
-    return NL_OK;
-
-  orig = nla_data(attrs[BATADV_ATTR_ORIG_ADDRESS]);
-  dest = nla_data(attrs[BATADV_ATTR_NEIGH_ADDRESS]);
-  tq = nla_get_u8(attrs[BATADV_ATTR_TQ]);
-  hardif = nla_get_u32(attrs[BATADV_ATTR_HARD_IFINDEX]);
+  orig = nla_data(attrs[ORIG_LIST_ATTR_ORIG_ADDRESS]);
+  dest = nla_data(attrs[ORIG_LIST_ATTR_NEIGH_ADDRESS]);
+  tq = nla_get_u8(attrs[ORIG_LIST_ATTR_TQ]);
+  hardif = nla_get_u32(attrs[ORIG_LIST_ATTR_HARD_IFINDEX]);
 
   if (memcmp(orig, dest, 6) != 0)
     return NL_OK;
@@ -66,59 +95,167 @@ static int parse_orig_list_netlink_cb(struct nl_msg *msg, void *arg)
   if (!ifname)
     return NL_OK;
 
-  sprintf(mac1, "%02x:%02x:%02x:%02x:%02x:%02x",
-          orig[0], orig[1], orig[2], orig[3], orig[4], orig[5]);
-
-  struct json_object *neigh = json_object_new_object();
-  if (!neigh)
+  if (opts->list->len == MAX_NEIGHBOURS)
     return NL_OK;
 
-  json_object_object_add(neigh, "tq", json_object_new_int(tq * 100 / 255));
-  json_object_object_add(neigh, "ifname", json_object_new_string(ifname));
-  json_object_object_add(neigh, "best", json_object_new_boolean(attrs[BATADV_ATTR_FLAG_BEST]));
-
-  json_object_object_add(opts->obj, mac1, neigh);
+  neigh = &opts->list->neighbours[opts->list->len++];
+  memcpy(neigh->addr, orig, sizeof(neigh->addr));
+  neigh->tq = tq * 100 / 255;
+  neigh->best = !!attrs[ORIG_LIST_ATTR_FLAG_BEST];
+  strncpy(neigh->ifname, ifname, sizeof(neigh->ifname) - 1);
+  neigh->ifname[sizeof(neigh->ifname) - 1] = '\0';
 
   return NL_OK;
 }
 
-static json_object *neighbours(void) {
+static int compare_neighbours(const void *a, const void *b) {
+  return memcmp(((const struct neighbour *)a)->addr, ((const struct neighbour *)b)->addr, 6);
+}
+
+static bool neighbours(struct batadv_genl_session *session, struct neighbour_list *list) {
   struct neigh_netlink_opts opts = {
+    .list = list,
     .query_opts = {
       .err = 0,
     },
   };
   int ret;
 
-  opts.obj = json_object_new_object();
-  if (!opts.obj)
-    return NULL;
+  list->len = 0;
+
+  ret = batadv_genl_session_query(session, BATADV_CMD_GET_ORIGINATORS,
+                                  parse_orig_list_netlink_cb, NLM_F_DUMP,
+                                  &opts.query_opts);
+  if (ret < 0)
+    return false;
+
+  qsort(list->neighbours, list->len, sizeof(list->neighbours[0]), compare_neighbours);
+  return true;
+}
+
+static bool neighbour_changed(const struct neighbour *a, const struct neighbour *b) {
+  return abs(a->tq - b->tq) >= TQ_THRESHOLD || a->best != b->best || strcmp(a->ifname, b->ifname);
+}
+
+static void add_neighbour(struct json_object *obj, const uint8_t *addr, const struct neighbour *neigh) {
+  char mac[18];
+
+  sprintf(mac, "%02x:%02x:%02x:%02x:%02x:%02x",
+          addr[0], addr[1], addr[2], addr[3], addr[4], addr[5]);
 
-  ret = batadv_genl_query("bat0", BATADV_CMD_GET_ORIGINATORS,
-                          parse_orig_list_netlink_cb, NLM_F_DUMP,
-                          &opts.query_opts);
-  if (ret < 0) {
-    json_object_put(opts.obj);
-    return NULL;
+  if (!neigh) {
+    json_object_object_add(obj, mac, NULL);
+    return;
   }
 
-  return opts.obj;
+  struct json_object *val = json_object_new_object();
+  if (!val)
+    return;
+
+  json_object_object_add(val, "tq", json_object_new_int(neigh->tq));
+  json_object_object_add(val, "ifname", json_object_new_string(neigh->ifname));
+  json_object_object_add(val, "best", json_object_new_boolean(neigh->best));
+
+  json_object_object_add(obj, mac, val);
+}
+
+/*
+ * Adds the differences between the state last sent and the current dump to
+ * obj (with full, unchanged neighbours are added as well) and returns their
+ * number. The resulting state last sent is stored in next.
+ */
+static size_t diff_neighbours(struct json_object *obj, const struct neighbour_list *sent,
+                              const struct neighbour_list *cur, struct neighbour_list *next,
+                              bool full) {
+  size_t i = 0, j = 0, changes = 0;
+
+  next->len = 0;
+
+  while (i < cur->len || j < sent->len) {
+    const struct neighbour *c = i < cur->len ? &cur->neighbours[i] : NULL;
+    const struct neighbour *s = j < sent->len ? &sent->neighbours[j] : NULL;
+    int cmp = !s ? -1 : !c ? 1 : compare_neighbours(c, s);
+
+    if (cmp > 0) {
+      add_neighbour(obj, s->addr, NULL);
+      changes++;
+      j++;
+      continue;
+    }
+
+    if (cmp < 0 || neighbour_changed(c, s)) {
+      add_neighbour(obj, c->addr, c);
+      next->neighbours[next->len++] = *c;
+      changes++;
+    } else if (full) {
+      add_neighbour(obj, c->addr, c);
+      next->neighbours[next->len++] = *c;
+    } else {
+      next->neighbours[next->len++] = *s;
+    }
+
+    i++;
+    if (cmp == 0)
+      j++;
+  }
+
+  return changes;
+}
+
+static time_t now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
 }
 
 int main(void) {
-  struct json_object *obj;
+  static struct neighbour_list lists[3];
+  struct neighbour_list *sent = &lists[0], *cur = &lists[1], *next = &lists[2];
+  struct batadv_genl_session session;
+  /* time of the last event with all neighbours */
+  time_t keyframe = now() - KEYFRAME_INTERVAL;
+  unsigned int interval = POLL_MIN;
+
+  /* The session connects lazily and reconnects by itself, failed polls are retried */
+  batadv_genl_session_open(&session, "bat0");
 
   printf("Content-type: text/event-stream\n\n");
   fflush(stdout);
 
   while (1) {
-    obj = neighbours();
-    if (obj) {
-      printf("data: %s\n\n", json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN));
-      fflush(stdout);
+    if (neighbours(&session, cur)) {
+      struct json_object *obj = json_object_new_object();
+      if (!obj)
+        return 1;
+
+      bool full = now() - keyframe >= KEYFRAME_INTERVAL;
+      size_t changes = diff_neighbours(obj, sent, cur, next, full);
+
+      if (full || changes) {
+        printf("data: %s\n\n", json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN));
+        fflush(stdout);
+      }
       json_object_put(obj);
+
+      struct neighbour_list *tmp = sent;
+      sent = next;
+      next = tmp;
+
+      if (full)
+        keyframe = now();
+
+      if (changes)
+        interval = POLL_MIN;
+      else if (interval < POLL_MAX)
+        interval = interval * 2 < POLL_MAX ? interval * 2 : POLL_MAX;
     }
-    sleep(10);
+
+    time_t until_keyframe = keyframe + KEYFRAME_INTERVAL - now();
+    if (until_keyframe > 0 && (time_t)interval > until_keyframe)
+      sleep(until_keyframe);
+    else
+      sleep(interval);
   }
 
   return 0;
@@ -763,9 +763,12 @@
 		}
 
 		if (wireless) {
+			// Only added or changed stations are sent, removed ones are null
 			add_event_source('/cgi-bin/dyn/stations?' + encodeURIComponent(ifname), function(data) {
 				Object.keys(data).forEach(function (addr) {
 					var wifi = data[addr];
+					if (!wifi)
+						return;
 
 					get_neigh(addr).update_wifi(wifi);
 				});
@@ -788,9 +791,13 @@
 
 	var mesh_provider = document.body.getAttribute('data-mesh-provider');
 	if (mesh_provider) {
+		// Only new or changed neighbours are sent, removed ones are null
 		add_event_source(mesh_provider, function(data) {
 			Object.keys(data).forEach(function (addr) {
 				var mesh = data[addr];
+				if (!mesh)
+					return;
+
 				var iface = interfaces[mesh.ifname];
 				if (!iface)
 					return;
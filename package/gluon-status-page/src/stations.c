@@ -1,43 +1,193 @@
+/*
+ * Streams the stations of a wifi interface to the status page. The stations
+ * are dumped via nl80211 every TICK_INTERVAL into a fixed array, which is
+ * compared with the previous dump. Each event only contains the stations
+ * which were added or changed, with removed stations mapped to null. Every
+ * KEYFRAME_TICKS, all stations are sent again.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <json-c/json.h>
-#include <iwinfo.h>
 #include <net/if.h>
 #include <glob.h>
 #include <alloca.h>
+#include <limits.h>
+
+#include <linux/nl80211.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/genl/genl.h>
 
 #define NETIF_PREFIX "/sys/class/net/"
 #define VIRTIF_PREFIX "/sys/devices/virtual/net/"
 #define LOWERGLOB_SUFFIX "/lower_*"
 
-static struct json_object *get_stations(const struct iwinfo_ops *iw, const char *ifname) {
-  int len;
-  char buf[IWINFO_BUFSIZE];
-  struct json_object *stations = json_object_new_object();
+#define TICK_INTERVAL 150000 /* us */
+#define KEYFRAME_TICKS 67 /* about 10 s */
+#define MAX_STATIONS 256
+
+// stations inactive for longer are shown as such by the status page
+#define INACTIVE_LIMIT 200
+
+struct station {
+  uint8_t mac[6];
+  int8_t signal;
+  uint32_t inactive;
+};
+
+struct station_list {
+  struct station stations[MAX_STATIONS];
+  size_t len;
+};
+
+static struct nl_sock *nl80211;
+static int nl80211_id;
+
+static int add_station(struct nl_msg *msg, void *arg) {
+  struct nlattr *tb[NL80211_ATTR_MAX + 1];
+  struct nlattr *sinfo[NL80211_STA_INFO_MAX + 1];
+  struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+  struct station_list *list = arg;
+
+  if (list->len == MAX_STATIONS)
+    return NL_SKIP;
+
+  if (nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0), NULL))
+    return NL_SKIP;
+
+  if (!tb[NL80211_ATTR_MAC] || !tb[NL80211_ATTR_STA_INFO])
+    return NL_SKIP;
+
+  if (nla_parse_nested(sinfo, NL80211_STA_INFO_MAX, tb[NL80211_ATTR_STA_INFO], NULL))
+    return NL_SKIP;
+
+  struct station *station = &list->stations[list->len++];
+  memset(station, 0, sizeof(*station));
+  memcpy(station->mac, nla_data(tb[NL80211_ATTR_MAC]), sizeof(station->mac));
+
+  if (sinfo[NL80211_STA_INFO_SIGNAL])
+    station->signal = (int8_t)nla_get_u8(sinfo[NL80211_STA_INFO_SIGNAL]);
+  if (sinfo[NL80211_STA_INFO_INACTIVE_TIME])
+    station->inactive = nla_get_u32(sinfo[NL80211_STA_INFO_INACTIVE_TIME]);
+
+  return NL_OK;
+}
+
+// status is 1 after a complete dump, a negative error code on failure
+static int finish_cb(struct nl_msg *msg, void *arg) {
+  int *status = arg;
+
+  *status = 1;
+  return NL_STOP;
+}
+
+static int error_cb(struct sockaddr_nl *nla, struct nlmsgerr *nlerr, void *arg) {
+  int *status = arg;
+
+  *status = nlerr->error < 0 ? nlerr->error : -EIO;
+  return NL_STOP;
+}
+
+static int compare_stations(const void *a, const void *b) {
+  return memcmp(((const struct station *)a)->mac, ((const struct station *)b)->mac, 6);
+}
+
+// a single NL80211_CMD_GET_STATION dump, sorted by MAC address
+static bool get_stations(unsigned ifindex, struct station_list *list) {
+  struct nl_msg *msg = nlmsg_alloc();
+  struct nl_cb *cb = nl_cb_alloc(NL_CB_DEFAULT);
+  int status = 0;
+  int ret = -1;
+
+  list->len = 0;
+
+  if (!msg || !cb)
+    goto out;
+
+  nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, add_station, list);
+  nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, finish_cb, &status);
+  nl_cb_err(cb, NL_CB_CUSTOM, error_cb, &status);
+
+  genlmsg_put(msg, NL_AUTO_PID, NL_AUTO_SEQ, nl80211_id, 0, NLM_F_DUMP, NL80211_CMD_GET_STATION, 0);
+  nla_put_u32(msg, NL80211_ATTR_IFINDEX, ifindex);
 
-  if (iw->assoclist(ifname, buf, &len) == -1)
-    return stations;
+  ret = nl_send_auto_complete(nl80211, msg);
+  if (ret >= 0)
+    ret = nl_recvmsgs(nl80211, cb);
 
-  // This is just: for entry in assoclist(ifname)
-  for (struct iwinfo_assoclist_entry *entry = (struct iwinfo_assoclist_entry *)buf;
-      (char*)(entry+1) <= buf + len; entry++) {
-    struct json_object *station = json_object_new_object();
+out:
+  nlmsg_free(msg);
+  nl_cb_put(cb);
 
-    json_object_object_add(station, "signal", json_object_new_int(entry->signal));
-    json_object_object_add(station, "noise", json_object_new_int(entry->noise));
-    json_object_object_add(station, "inactive", json_object_new_int(entry->inactive));
+  if (ret < 0 || status != 1)
+    return false;
 
-    char macstr[18];
+  qsort(list->stations, list->len, sizeof(list->stations[0]), compare_stations);
+  return true;
+}
+
+// inactivity as shown by the status page: whole seconds and the inactive flag
+static bool inactive_changed(uint32_t a, uint32_t b) {
+  return (a > INACTIVE_LIMIT) != (b > INACTIVE_LIMIT) || (a + 500) / 1000 != (b + 500) / 1000;
+}
+
+static bool station_changed(const struct station *a, const struct station *b) {
+  return a->signal != b->signal || inactive_changed(a->inactive, b->inactive);
+}
+
+static void print_mac(const uint8_t *mac, bool *first) {
+  printf("%s\"%02x:%02x:%02x:%02x:%02x:%02x\":", *first ? "data: {" : ",",
+      mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  *first = false;
+}
+
+static void print_station(const struct station *station, bool *first) {
+  print_mac(station->mac, first);
+  printf("{\"signal\":%d,\"inactive\":%u}", station->signal, (unsigned)station->inactive);
+}
+
+// prints the difference between two sorted lists, all of cur if prev is NULL
+static void print_event(const struct station_list *prev, const struct station_list *cur) {
+  size_t i = 0, j = 0;
+  bool first = true;
+
+  while (i < cur->len || (prev && j < prev->len)) {
+    int cmp;
+
+    if (!prev || j == prev->len)
+      cmp = -1;
+    else if (i == cur->len)
+      cmp = 1;
+    else
+      cmp = compare_stations(&cur->stations[i], &prev->stations[j]);
+
+    if (cmp < 0) {
+      print_station(&cur->stations[i++], &first);
+    } else if (cmp > 0) {
+      print_mac(prev->stations[j++].mac, &first);
+      fputs("null", stdout);
+    } else {
+      if (station_changed(&cur->stations[i], &prev->stations[j]))
+        print_station(&cur->stations[i], &first);
+      i++;
+      j++;
+    }
+  }
 
-    snprintf(macstr, sizeof(macstr), "%02x:%02x:%02x:%02x:%02x:%02x",
-        entry->mac[0], entry->mac[1], entry->mac[2],
-        entry->mac[3], entry->mac[4], entry->mac[5]);
+  if (first) {
+    // nothing has changed, only keyframes are sent when empty
+    if (prev)
+      return;
 
-    json_object_object_add(stations, macstr, station);
+    fputs("data: {", stdout);
   }
 
-  return stations;
+  fputs("}\n\n", stdout);
+  fflush(stdout);
 }
 
 static void badrequest() {
@@ -106,20 +256,45 @@ int main(int argc, char *argv[]) {
   if (!interface_get_lowest(ifname, hwifname))
     badrequest();
 
-  const struct iwinfo_ops *iw = iwinfo_backend(hwifname);
+  unsigned ifindex = if_nametoindex(hwifname);
+  if (!ifindex)
+    badrequest();
+
+  nl80211 = nl_socket_alloc();
+  if (!nl80211 || genl_connect(nl80211))
+    badrequest();
+
+  nl80211_id = genl_ctrl_resolve(nl80211, NL80211_GENL_NAME);
+  if (nl80211_id < 0)
+    badrequest();
+
+  static struct station_list lists[2];
+  struct station_list *prev = &lists[0], *cur = &lists[1];
+  unsigned tick = 0;
 
-  if (iw == NULL)
+  if (!get_stations(ifindex, prev))
     badrequest();
 
   printf("Content-type: text/event-stream\n\n");
+  print_event(NULL, prev);
 
   while (true) {
-    struct json_object *obj;
-    obj = get_stations(iw, hwifname);
-    printf("data: %s\n\n", json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN));
-    fflush(stdout);
-    json_object_put(obj);
-    usleep(150000);
+    usleep(TICK_INTERVAL);
+
+    // the page reconnects after a few seconds
+    if (!get_stations(ifindex, cur))
+      return 1;
+
+    if (++tick == KEYFRAME_TICKS) {
+      tick = 0;
+      print_event(NULL, cur);
+    } else {
+      print_event(prev, cur);
+    }
+
+    struct station_list *tmp = prev;
+    prev = cur;
+    cur = tmp;
   }
 
   return 0;
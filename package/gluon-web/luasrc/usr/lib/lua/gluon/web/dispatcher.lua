@@ -210,4 +210,6 @@ return function(config, http)
 		http:prepare_content("text/plain")
 		http:write(err)
 	end
+
+	http:close()
 end
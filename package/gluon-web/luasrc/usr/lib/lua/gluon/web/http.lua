@@ -4,6 +4,7 @@
 
 local protocol = require "gluon.web.http.protocol"
 local util  = require "gluon.web.util"
+local tparser = require "gluon.web.template.parser"
 
 
 local M = {}
@@ -14,6 +15,9 @@ M.Http = Http
 function Http:__init__(env, input, output)
 	self.input = input
 	self.output = output
+	-- Templates produce many small writes; they are collected and passed
+	-- to the output in large blocks
+	self.buffer = tparser.buffer(output)
 
 	self.request = {
 		env = env,
@@ -27,9 +31,9 @@ local function push_headers(self)
 	if self.eoh then return end
 
 	for _, header in pairs(self.headers) do
-		self.output:write(string.format("%s: %s\r\n", header[1], header[2]))
+		self.buffer:write(string.format("%s: %s\r\n", header[1], header[2]))
 	end
-	self.output:write("\r\n")
+	self.buffer:write("\r\n")
 
 	self.eoh = true
 end
@@ -66,6 +70,7 @@ function Http:close()
 
 	push_headers(self)
 
+	self.buffer:flush()
 	self.output:flush()
 	self.output:close()
 	self.output = nil
@@ -94,10 +99,10 @@ function Http:status(code, request)
 	code = code or 200
 	request = request or "OK"
 	self.code = code
-	self.output:write(string.format("Status: %i %s\r\n", code, request))
+	self.buffer:write(string.format("Status: %i %s\r\n", code, request))
 end
 
-function Http:write(content)
+function Http:write(...)
 	if not self.output then return end
 
 	self:status()
@@ -110,7 +115,7 @@ function Http:write(content)
 	end
 
 	push_headers(self)
-	self.output:write(content)
+	self.buffer:write(...)
 end
 
 function Http:redirect(url)
@@ -3,9 +3,55 @@
 -- Licensed to the public under the Apache License 2.0.
 
 local tparser = require 'gluon.web.template.parser'
+local stat = require 'posix.sys.stat'
 
 local tostring, ipairs, setmetatable, setfenv = tostring, ipairs, setmetatable, setfenv
-local pcall, assert = pcall, assert
+local pcall, assert, loadfile, loadstring = pcall, assert, loadfile, loadstring
+local dump = string.dump
+
+
+-- Compiled templates by file, with the mtime of the file. The bytecode is
+-- cached rather than the function itself, as each render sets its own
+-- environment, and the same template may be rendered recursively.
+local cache = {}
+
+local function mtime(file)
+	local st = stat.stat(file)
+	return st and st.st_mtime
+end
+
+-- Loads a template from the cache, from a view precompiled at build time
+-- (<name>.lc, used unless the .html is newer) or by parsing <name>.html
+local function load_template(path)
+	local sourcefile, compiled = path .. '.html', path .. '.lc'
+	local source_mtime, compiled_mtime = mtime(sourcefile), mtime(compiled)
+
+	local file, file_mtime = sourcefile, source_mtime
+	if compiled_mtime and not (source_mtime and source_mtime > compiled_mtime) then
+		file, file_mtime = compiled, compiled_mtime
+	end
+
+	local entry = cache[file]
+	if entry and entry.mtime == file_mtime then
+		return loadstring(entry.code, file)
+	end
+
+	local template, err, _
+	if file == compiled then
+		template, err = loadfile(compiled)
+	else
+		template, _, err = tparser.parse(sourcefile)
+	end
+
+	if template and file_mtime then
+		cache[file] = {
+			mtime = file_mtime,
+			code = dump(template),
+		}
+	end
+
+	return template, err
+end
 
 
 return function(config, env)
@@ -66,11 +112,11 @@ return function(config, env)
 	-- @param scope		Scope to assign to template (optional)
 	-- @param pkg		i18n namespace package (optional)
 	function ctx.render(name, scope, pkg)
-		local sourcefile = viewdir .. name .. ".html"
-		local template, _, err = tparser.parse(sourcefile)
+		local path = viewdir .. name
+		local template, err = load_template(path)
 
 		assert(template, "Failed to load template '" .. name .. "'.\n" ..
-			"Error while parsing template '" .. sourcefile .. "':\n" ..
+			"Error while parsing template '" .. path .. ".html':\n" ..
 			(err or "Unknown syntax error"))
 
 		render_template(name, template, scope, pkg)
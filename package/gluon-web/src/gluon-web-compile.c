@@ -0,0 +1,92 @@
+/*
+ * gluon-web Template - precompiler
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Compiles a template to Lua bytecode at build time, which is loaded by
+ * gluon.web.template instead of parsing the template on the node.
+ */
+
+#include "template_parser.h"
+
+#include <lauxlib.h>
+#include <lualib.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+__attribute__((noreturn))
+static void die(const char *msg)
+{
+	fprintf(stderr, "Error: %s\n", msg);
+	exit(1);
+}
+
+__attribute__((noreturn))
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s input.html output.lc [chunkname]\n", name);
+	exit(1);
+}
+
+static int writer(lua_State *L __attribute__((unused)), const void *p, size_t sz, void *ud)
+{
+	return fwrite(p, 1, sz, ud) != sz;
+}
+
+int main(int argc, char *argv[])
+{
+	struct template_parser *parser;
+	const char *chunkname;
+	lua_State *L;
+	FILE *out;
+
+	if (argc != 3 && argc != 4)
+		usage(argv[0]);
+
+	/* The chunkname should be the path on the node for error messages */
+	chunkname = argc == 4 ? argv[3] : argv[1];
+
+	L = luaL_newstate();
+	if (!L)
+		die("Out of memory");
+
+	parser = template_open(argv[1]);
+	if (!parser) {
+		fprintf(stderr, "Error: Unable to open %s: %s\n", argv[1], strerror(errno));
+		exit(1);
+	}
+
+	if (lua_load(L, template_reader, parser, chunkname)) {
+		template_error(L, parser);
+		die(lua_tostring(L, -1));
+	}
+
+	template_close(parser);
+
+	out = fopen(argv[2], "w");
+	if (!out)
+		die("Unable to open output file");
+
+	if (lua_dump(L, writer, out) || fclose(out))
+		die("Unable to write output file");
+
+	lua_close(L);
+
+	return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * gluon-web Template - pcdata() benchmark
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Compares the table-driven pcdata() with the previous byte-by-byte
+ * implementation, which is kept here as a reference: both must return the
+ * same output for a set of strings as they appear in the config mode and for
+ * random input. Afterwards, the time per call is measured for both on the
+ * config mode strings.
+ *
+ * Built and run on the build host with "make bench".
+ */
+
+/* validate_utf8() is static, so the implementation is included directly */
+#include "template_utils.c"
+
+#include <stdio.h>
+#include <time.h>
+
+
+#define BENCH_CALLS 200000
+#define RANDOM_STRINGS 1000000
+
+
+static const char *const config_mode_strings[] = {
+	/* hostnames, contact info and geo coordinates */
+	"ffxx-musterstrasse-42",
+	"Maxi Mustermann <maxi@example.org>",
+	"53.07419",
+	"8.80786",
+	/* SSIDs and mesh IDs */
+	"musterstadt.freifunk.net",
+	"ueH3uXjdp",
+	/* fastd public key */
+	"8f2c6e57d3e9a5a0a6b2c6f1d4e5f6a7b8c9d0e1f2a3b4c5d6e7f8091a2b3c4d",
+	/* translated texts with umlauts and quotes */
+	"Wenn du deinen Knoten über das Internet mit dem Freifunk-Netz verbinden "
+	"möchtest, aktiviere „Mesh-VPN“ und trage deinen Schlüssel auf "
+	"<a href=\"https://musterstadt.freifunk.net/knoten\">unserer Seite</a> ein.",
+	"Gib hier die Bandbreite ein, die der Knoten für das Mesh-VPN nutzen darf "
+	"(Download & Upload in kbit/s). Trage 0 ein, um sie nicht zu begrenzen.",
+	"Your node's setup is now complete. Please make sure it's connected to the "
+	"Internet & that the 'Mesh VPN' key has been registered.",
+	/* attribute values with JSON */
+	"{\"type\":\"dependency\",\"id\":\"id.1.1.meshvpn\",\"value\":\"1\"}",
+	/* invalid and control bytes */
+	"broken\x01\x7f value\xff\xc3",
+};
+
+/* previous implementation of pcdata() */
+static bool pcdata_reference(const char *s, size_t l, char **out, size_t *outl)
+{
+	struct template_buffer *buf = buf_init(l);
+	const unsigned char *ptr = (const unsigned char *)s;
+	size_t o, v;
+	char esq[8];
+	int esl;
+
+	if (!buf)
+		return false;
+
+	for (o = 0; o < l; o++)	{
+		/* Invalid XML bytes */
+		if ((*ptr <= 0x08) ||
+		    ((*ptr >= 0x0B) && (*ptr <= 0x0C)) ||
+		    ((*ptr >= 0x0E) && (*ptr <= 0x1F)) ||
+		    (*ptr == 0x7F)) {
+			ptr++;
+		}
+
+		/* Escapes */
+		else if ((*ptr == '\'') ||
+		         (*ptr == '"') ||
+		         (*ptr == '&') ||
+		         (*ptr == '<') ||
+		         (*ptr == '>')) {
+			esl = snprintf(esq, sizeof(esq), "&#%i;", *ptr);
+
+			if (!buf_append(buf, esq, esl))
+				break;
+
+			ptr++;
+		}
+
+		/* ascii char */
+		else if (*ptr <= 0x7F) {
+			buf_putchar(buf, (char)*ptr++);
+		}
+
+		/* multi byte sequence */
+		else {
+			if (!(v = validate_utf8(&ptr, l - o, buf)))
+				break;
+
+			o += (v - 1);
+		}
+	}
+
+	*outl = buf_length(buf);
+	*out = buf_destroy(buf);
+	return true;
+}
+
+typedef bool (*pcdata_fn)(const char *s, size_t l, char **out, size_t *outl);
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool compare(const char *s, size_t l)
+{
+	char *a, *b;
+	size_t al, bl;
+	bool ret;
+
+	if (!pcdata_reference(s, l, &a, &al) || !pcdata(s, l, &b, &bl)) {
+		fprintf(stderr, "Error: Out of memory\n");
+		exit(1);
+	}
+
+	ret = (al == bl && !memcmp(a, b, al));
+
+	free(a);
+	free(b);
+	return ret;
+}
+
+/* random strings with a bias towards special chars and UTF-8 sequences */
+static bool compare_random(void)
+{
+	static const char special[] = "<>&'\"\n\t\r";
+	char s[64];
+	size_t i, l;
+	int n;
+
+	srand(1);
+
+	for (n = 0; n < RANDOM_STRINGS; n++) {
+		l = rand() % sizeof(s);
+
+		for (i = 0; i < l; i++) {
+			switch (rand() % 4) {
+			case 0:
+				s[i] = rand();
+				break;
+			case 1:
+				s[i] = special[rand() % (sizeof(special) - 1)];
+				break;
+			case 2:
+				s[i] = 0x80 + rand() % 0x80;
+				break;
+			default:
+				s[i] = 'a' + rand() % 26;
+			}
+		}
+
+		if (!compare(s, l)) {
+			fprintf(stderr, "Error: Output differs for random string %i\n", n);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static double bench(pcdata_fn fn)
+{
+	const size_t num = sizeof(config_mode_strings) / sizeof(config_mode_strings[0]);
+	size_t lens[num], i;
+	double t;
+	int n;
+
+	for (i = 0; i < num; i++)
+		lens[i] = strlen(config_mode_strings[i]);
+
+	t = now();
+
+	for (n = 0; n < BENCH_CALLS; n++) {
+		for (i = 0; i < num; i++) {
+			char *out;
+			size_t outl;
+
+			if (fn(config_mode_strings[i], lens[i], &out, &outl))
+				free(out);
+		}
+	}
+
+	return (now() - t) / ((double)BENCH_CALLS * num);
+}
+
+int main(void)
+{
+	size_t i;
+	double ref, cur;
+
+	for (i = 0; i < sizeof(config_mode_strings) / sizeof(config_mode_strings[0]); i++) {
+		if (!compare(config_mode_strings[i], strlen(config_mode_strings[i]))) {
+			fprintf(stderr, "Error: Output differs for \"%s\"\n", config_mode_strings[i]);
+			return 1;
+		}
+	}
+
+	if (!compare_random())
+		return 1;
+
+	ref = bench(pcdata_reference);
+	cur = bench(pcdata);
+
+	printf("Output identical for config mode and %i random strings\n", RANDOM_STRINGS);
+	printf("pcdata(): %.1f ns per call (previous implementation: %.1f ns)\n",
+	       cur * 1e9, ref * 1e9);
+
+	return 0;
+}
@@ -30,6 +30,16 @@
 
 
 #define TEMPLATE_CATALOG "gluon.web.template.parser.catalog"
+#define TEMPLATE_BUFFER "gluon.web.template.parser.buffer"
+
+/* default number of bytes collected before they are passed to the output */
+#define TEMPLATE_BUFFER_SIZE 16384
+
+
+struct template_output {
+	struct template_buffer *buf;
+	size_t limit;
+};
 
 
 static int template_L_do_parse(lua_State *L, struct template_parser *parser, const char *chunkname)
@@ -124,11 +134,100 @@ static int template_catalog_gc(lua_State *L)
 	return 0;
 }
 
+/* calls output:write(s); the output is kept in the environment of the buffer */
+static void template_output_write(lua_State *L, const char *s, size_t len)
+{
+	lua_getfenv(L, 1);
+	lua_rawgeti(L, -1, 1);
+	lua_getfield(L, -1, "write");
+	lua_insert(L, -2);
+	lua_pushlstring(L, s, len);
+	lua_call(L, 2, 0);
+	lua_pop(L, 1);
+}
+
+static void template_output_flush(lua_State *L, struct template_output *out)
+{
+	size_t len = buf_length(out->buf);
+	if (!len)
+		return;
+
+	/* reset before calling out, so the data isn't written twice on errors */
+	out->buf->dptr = out->buf->data;
+	template_output_write(L, out->buf->data, len);
+}
+
+static int template_L_buffer(lua_State *L)
+{
+	lua_Integer limit = luaL_optinteger(L, 2, TEMPLATE_BUFFER_SIZE);
+	luaL_checkany(L, 1);
+	luaL_argcheck(L, limit > 0, 2, "buffer size must be positive");
+
+	struct template_output *out = lua_newuserdata(L, sizeof(*out));
+	out->limit = limit;
+	out->buf = buf_init(limit);
+	if (!out->buf)
+		return luaL_error(L, "out of memory");
+
+	luaL_getmetatable(L, TEMPLATE_BUFFER);
+	lua_setmetatable(L, -2);
+
+	lua_createtable(L, 1, 0);
+	lua_pushvalue(L, 1);
+	lua_rawseti(L, -2, 1);
+	lua_setfenv(L, -2);
+
+	return 1;
+}
+
+static int template_buffer_write(lua_State *L)
+{
+	struct template_output *out = luaL_checkudata(L, 1, TEMPLATE_BUFFER);
+	int i, n = lua_gettop(L);
+
+	for (i = 2; i <= n; i++) {
+		size_t len;
+		const char *s = luaL_checklstring(L, i, &len);
+
+		/* large chunks are passed on without copying them */
+		if (len >= out->limit && !buf_length(out->buf)) {
+			template_output_write(L, s, len);
+			continue;
+		}
+
+		if (!buf_append(out->buf, s, len))
+			return luaL_error(L, "out of memory");
+
+		if (buf_length(out->buf) >= out->limit)
+			template_output_flush(L, out);
+	}
+
+	return 0;
+}
+
+static int template_buffer_flush(lua_State *L)
+{
+	struct template_output *out = luaL_checkudata(L, 1, TEMPLATE_BUFFER);
+	template_output_flush(L, out);
+
+	return 0;
+}
+
+static int template_buffer_gc(lua_State *L)
+{
+	struct template_output *out = luaL_checkudata(L, 1, TEMPLATE_BUFFER);
+	if (out->buf)
+		free(buf_destroy(out->buf));
+
+	return 0;
+}
+
 static const luaL_reg R[] = {
 	{ "parse",          template_L_parse },
 	{ "parse_string",   template_L_parse_string },
 	{ "pcdata",         template_L_pcdata },
 	{ "load_catalog",   template_L_load_catalog },
+	{ "buffer",         template_L_buffer },
 	{}
 };
 
@@ -138,6 +237,13 @@ static const luaL_reg template_catalog_methods[] = {
 	{}
 };
 
+static const luaL_reg template_buffer_methods[] = {
+	{ "write", template_buffer_write },
+	{ "flush", template_buffer_flush },
+	{ "__gc",  template_buffer_gc },
+	{}
+};
+
 __attribute__ ((visibility("default")))
 LUALIB_API int luaopen_gluon_web_template_parser(lua_State *L) {
 	luaL_register(L, "gluon.web.template.parser", R);
@@ -146,5 +252,11 @@ LUALIB_API int luaopen_gluon_web_template_parser(lua_State *L) {
 	luaL_register(L, NULL, template_catalog_methods);
 	lua_pop(L, 1);
 
+	luaL_newmetatable(L, TEMPLATE_BUFFER);
+	luaL_register(L, NULL, template_buffer_methods);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+
 	return 1;
 }
@@ -21,7 +21,6 @@
 #include "template_lmo.h"
 
 #include <stdlib.h>
-#include <stdio.h>
 #include <string.h>
 
 /* initialize a buffer object */
@@ -253,54 +252,79 @@ static size_t validate_utf8(const unsigned char **s, size_t l, struct template_b
 	return o;
 }
 
+/* byte classes for pcdata() */
+enum {
+	PCDATA_COPY = 0,	/* ASCII char that is copied as is */
+	PCDATA_SKIP,		/* invalid XML byte */
+	PCDATA_ESCAPE,		/* XML control char */
+	PCDATA_UTF8,		/* start of a multi byte sequence */
+};
+
+static const unsigned char pcdata_class[256] = {
+	[0x00 ... 0x08] = PCDATA_SKIP,
+	[0x0B ... 0x0C] = PCDATA_SKIP,
+	[0x0E ... 0x1F] = PCDATA_SKIP,
+	[0x7F]          = PCDATA_SKIP,
+
+	['\'']          = PCDATA_ESCAPE,
+	['"']           = PCDATA_ESCAPE,
+	['&']           = PCDATA_ESCAPE,
+	['<']           = PCDATA_ESCAPE,
+	['>']           = PCDATA_ESCAPE,
+
+	[0x80 ... 0xFF] = PCDATA_UTF8,
+};
+
+/* all escapes have the same length */
+#define PCDATA_ESCAPE_LEN 5
+
+static const char *const pcdata_escape[256] = {
+	['\''] = "&#39;",
+	['"']  = "&#34;",
+	['&']  = "&#38;",
+	['<']  = "&#60;",
+	['>']  = "&#62;",
+};
+
 /* Sanitize given string and strip all invalid XML bytes
  * Validate UTF-8 sequences
  * Escape XML control chars */
 bool pcdata(const char *s, size_t l, char **out, size_t *outl)
 {
-	struct template_buffer *buf = buf_init(l);
-	const unsigned char *ptr = (const unsigned char *)s;
-	size_t o, v;
-	char esq[8];
-	int esl;
+	/* leave some room for escapes, so the buffer rarely needs to grow */
+	struct template_buffer *buf = buf_init(l + l/8 + 32);
+	const unsigned char *ptr = (const unsigned char *)s, *end = ptr + l;
 
 	if (!buf)
 		return false;
 
-	for (o = 0; o < l; o++)	{
-		/* Invalid XML bytes */
-		if ((*ptr <= 0x08) ||
-		    ((*ptr >= 0x0B) && (*ptr <= 0x0C)) ||
-		    ((*ptr >= 0x0E) && (*ptr <= 0x1F)) ||
-		    (*ptr == 0x7F)) {
+	while (ptr < end) {
+		/* copy runs of plain ASCII chars at once */
+		const unsigned char *run = ptr;
+		while (ptr < end && pcdata_class[*ptr] == PCDATA_COPY)
 			ptr++;
-		}
 
-		/* Escapes */
-		else if ((*ptr == '\'') ||
-		         (*ptr == '"') ||
-		         (*ptr == '&') ||
-		         (*ptr == '<') ||
-		         (*ptr == '>')) {
-			esl = snprintf(esq, sizeof(esq), "&#%i;", *ptr);
+		if (ptr > run && !buf_append(buf, (const char *)run, ptr - run))
+			break;
 
-			if (!buf_append(buf, esq, esl))
-				break;
+		if (ptr == end)
+			break;
 
+		if (pcdata_class[*ptr] == PCDATA_SKIP) {
 			ptr++;
 		}
 
-		/* ascii char */
-		else if (*ptr <= 0x7F) {
-			buf_putchar(buf, (char)*ptr++);
+		else if (pcdata_class[*ptr] == PCDATA_ESCAPE) {
+			if (!buf_append(buf, pcdata_escape[*ptr], PCDATA_ESCAPE_LEN))
+				break;
+
+			ptr++;
 		}
 
 		/* multi byte sequence */
 		else {
-			if (!(v = validate_utf8(&ptr, l - o, buf)))
+			if (!validate_utf8(&ptr, end - ptr, buf))
 				break;
-
-			o += (v - 1);
 		}
 	}
 
@@ -38,6 +38,13 @@ ifneq ($(wildcard ./i18n/.),)
   PKG_CONFIG_DEPENDS += $(GLUON_I18N_CONFIG)
 endif
 
+GLUON_VIEWS := $(wildcard ./files/lib/gluon/*/view/. ./luasrc/lib/gluon/*/view/.)
+
+ifneq ($(GLUON_VIEWS),)
+  PKG_BUILD_DEPENDS += gluon-web/host
+  PKG_CONFIG_DEPENDS += CONFIG_GLUON_WEB_PRECOMPILE_VIEWS
+endif
+
 
 define GluonBuildI18N
 	mkdir -p $$(PKG_BUILD_DIR)/i18n
@@ -58,6 +65,14 @@ define GluonInstallI18N
 	done
 endef
 
+# Replaces each view by Lua bytecode, which gluon-web loads without parsing the template
+define GluonCompileViews
+	set -e; $(FIND) $(1)/lib/gluon/*/view -type f -name '*.html' | while read src; do \
+		gluon-web-compile "$$$$src" "$$$${src%.html}.lc" "$$$${src#$(1)}"; \
+		rm "$$$$src"; \
+	done
+endef
+
 define GluonSrcDiet
 	rm -rf $(2)
 	$(CP) $(1) $(2)
@@ -101,6 +116,9 @@ define Gluon/Build/Install
 	$(if $(wildcard ./i18n/.),
 		$(GluonInstallI18N)
 	)
+	$(if $(CONFIG_GLUON_WEB_PRECOMPILE_VIEWS),$(if $(GLUON_VIEWS),
+		$(GluonCompileViews)
+	))
 endef
 
 Build/Compile=$(call Gluon/Build/Compile)
@@ -26,6 +26,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -93,23 +94,177 @@ struct nla_policy batadv_genl_policy[NUM_BATADV_ATTR] = {
 					    .minlen = ETH_ALEN,
 					    .maxlen = ETH_ALEN },
 	[BATADV_ATTR_BLA_CRC]		= { .type = NLA_U16 },
+	[BATADV_ATTR_DAT_CACHE_IP4ADDRESS] = { .type = NLA_U32 },
+	[BATADV_ATTR_DAT_CACHE_HWADDRESS] = { .type = NLA_UNSPEC,
+					    .minlen = ETH_ALEN,
+					    .maxlen = ETH_ALEN },
+	[BATADV_ATTR_DAT_CACHE_VID]	= { .type = NLA_U16 },
+};
+
+/**
+ * attr_valid() - Check the length of an attribute against batadv_genl_policy
+ * @attr: attribute to check
+ * @type: &enum batadv_nl_attrs of @attr
+ *
+ * Return: true when @attr can be used safely, false otherwise
+ */
+static bool attr_valid(const struct nlattr *attr, int type)
+{
+	const struct nla_policy *pt = &batadv_genl_policy[type];
+	int len = nla_len(attr);
+	int minlen = pt->minlen;
+
+	if (!minlen) {
+		switch (pt->type) {
+		case NLA_U8:
+			minlen = sizeof(uint8_t);
+			break;
+		case NLA_U16:
+			minlen = sizeof(uint16_t);
+			break;
+		case NLA_U32:
+			minlen = sizeof(uint32_t);
+			break;
+		case NLA_U64:
+			minlen = sizeof(uint64_t);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (len < minlen)
+		return false;
+
+	if (pt->maxlen && len > pt->maxlen)
+		return false;
+
+	if (pt->type == NLA_STRING) {
+		const char *data = nla_data(attr);
+
+		if (len == 0 || data[len - 1] != '\0')
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * batadv_genl_parse() - Extract selected attributes of a batadv message
+ * @msg: netlink message received in a query callback
+ * @nl_cmd: &enum batadv_nl_commands the message must belong to
+ * @spec: list of requested attributes
+ * @attrs: output; attrs[i] is set to the attribute spec[i].id or NULL
+ * @num: number of entries in @spec and @attrs
+ *
+ * Unlike nla_parse() with batadv_genl_policy, this walks the attributes only
+ * once and validates (by length) only the requested ones, without filling a
+ * table of all BATADV_ATTR_MAX attributes.
+ *
+ * Return: 0 on success, -EINVAL when the message has an invalid header, is no
+ *  reply to @nl_cmd, a requested attribute is invalid or a mandatory one is
+ *  missing
+ */
+__attribute__ ((visibility ("default")))
+int batadv_genl_parse(struct nl_msg *msg, enum batadv_nl_commands nl_cmd,
+		      const struct batadv_genl_attr_spec spec[],
+		      struct nlattr *attrs[], size_t num)
+{
+	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct genlmsghdr *ghdr;
+	struct nlattr *attr;
+	size_t i;
+	enum batadv_nl_attrs type;
+	int rem;
+
+	if (!genlmsg_valid_hdr(nlh, 0))
+		return -EINVAL;
+
+	ghdr = nlmsg_data(nlh);
+
+	if (ghdr->cmd != nl_cmd)
+		return -EINVAL;
+
+	for (i = 0; i < num; i++)
+		attrs[i] = NULL;
+
+	nla_for_each_attr(attr, genlmsg_attrdata(ghdr, 0), genlmsg_len(ghdr),
+			  rem) {
+		type = nla_type(attr);
+
+		for (i = 0; i < num; i++) {
+			if (spec[i].id == type)
+				break;
+		}
+
+		if (i == num)
+			continue;
+
+		if (!attr_valid(attr, type))
+			return -EINVAL;
+
+		attrs[i] = attr;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (spec[i].mandatory && !attrs[i])
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+/**
+ * struct nlquery_state - receive state of the running query of a session
+ */
+struct nlquery_state {
+	/** @callback: receive callback of the running query */
+	nl_recvmsg_msg_cb_t callback;
+
+	/** @query_opts: &struct batadv_nlquery_opts of the running query */
+	struct batadv_nlquery_opts *query_opts;
+
+	/** @seq: sequence number of the running query */
+	uint32_t seq;
+
+	/** @done: final message (NLMSG_DONE or NLMSG_ERROR) was received */
+	bool done;
 };
 
+/**
+ * nlquery_valid_cb() - Forward a valid message to the running query
+ * @msg: netlink message being processed
+ * @arg: &struct nlquery_state of the session
+ *
+ * Return: return value of the callback of the running query
+ */
+static int nlquery_valid_cb(struct nl_msg *msg, void *arg)
+{
+	struct nlquery_state *state = arg;
+
+	/* leftover of an earlier query */
+	if (nlmsg_hdr(msg)->nlmsg_seq != state->seq)
+		return NL_SKIP;
+
+	return state->callback(msg, state->query_opts);
+}
+
 /**
  * nlquery_error_cb() - Store error value in &batadv_nlquery_opts->error and
  *  stop processing
  * @nla: netlink address of the peer
  * @nlerr: netlink error message being processed
- * @arg: &struct batadv_nlquery_opts given to batadv_genl_query()
+ * @arg: &struct nlquery_state of the session
  *
  * Return: Always NL_STOP
  */
 static int nlquery_error_cb(struct sockaddr_nl *nla __attribute__((unused)),
 			    struct nlmsgerr *nlerr, void *arg)
 {
-	struct batadv_nlquery_opts *query_opts = arg;
+	struct nlquery_state *state = arg;
 
-	query_opts->err = nlerr->error;
+	state->query_opts->err = nlerr->error;
+	state->done = true;
 
 	return NL_STOP;
 }
@@ -118,98 +273,364 @@ static int nlquery_error_cb(struct sockaddr_nl *nla __attribute__((unused)),
  * nlquery_stop_cb() - Store error value in &batadv_nlquery_opts->error and
  *  stop processing
  * @msg: netlink message being processed
- * @arg: &struct batadv_nlquery_opts given to batadv_genl_query()
+ * @arg: &struct nlquery_state of the session
  *
  * Return: Always NL_STOP
  */
 static int nlquery_stop_cb(struct nl_msg *msg, void *arg)
 {
 	struct nlmsghdr *nlh = nlmsg_hdr(msg);
-	struct batadv_nlquery_opts *query_opts = arg;
+	struct nlquery_state *state = arg;
 	int *error = nlmsg_data(nlh);
 
 	if (*error)
-		query_opts->err = *error;
+		state->query_opts->err = *error;
+
+	state->done = true;
 
 	return NL_STOP;
 }
 
 /**
- * batadv_genl_query() - Start a common batman-adv generic netlink query
- * @mesh_iface: name of the batman-adv mesh interface
+ * nlquery_cb_alloc() - Allocate the callbacks used by all queries of a session
+ * @state: receive state passed to the callbacks
+ *
+ * Return: new &struct nl_cb or NULL when out of memory
+ */
+static struct nl_cb *nlquery_cb_alloc(struct nlquery_state *state)
+{
+	struct nl_cb *cb;
+
+	cb = nl_cb_alloc(NL_CB_DEFAULT);
+	if (!cb)
+		return NULL;
+
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, nlquery_valid_cb, state);
+	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, nlquery_stop_cb, state);
+	nl_cb_err(cb, NL_CB_CUSTOM, nlquery_error_cb, state);
+
+	return cb;
+}
+
+/**
+ * session_disconnect() - Free the socket of a session
+ * @session: session to disconnect
+ *
+ * The resolved family and ifindex are kept, the socket is reestablished by
+ * the next query.
+ */
+static void session_disconnect(struct batadv_genl_session *session)
+{
+	if (!session->sock)
+		return;
+
+	nl_socket_free(session->sock);
+	session->sock = NULL;
+}
+
+/**
+ * session_connect() - Make sure a session has a usable socket and family id
+ * @session: session to connect
+ *
+ * Return: 0 on success or negative error value otherwise
+ */
+static int session_connect(struct batadv_genl_session *session)
+{
+	int ret;
+
+	if (!session->sock) {
+		session->sock = nl_socket_alloc();
+		if (!session->sock)
+			return -ENOMEM;
+
+		ret = genl_connect(session->sock);
+		if (ret < 0) {
+			session_disconnect(session);
+			return ret;
+		}
+	}
+
+	if (session->family < 0) {
+		session->family = genl_ctrl_resolve(session->sock,
+						    BATADV_NL_NAME);
+		if (session->family < 0)
+			return -EOPNOTSUPP;
+	}
+
+	if (!session->ifindex) {
+		session->ifindex = if_nametoindex(session->mesh_iface);
+		if (!session->ifindex)
+			return -ENODEV;
+	}
+
+	return 0;
+}
+
+/**
+ * session_query_once() - Send a query over a session and receive the reply
+ * @session: session to use
+ * @cb: callbacks allocated by nlquery_cb_alloc() for @state
+ * @state: receive state with callback and query_opts of the query
  * @nl_cmd: &enum batadv_nl_commands which should be sent to kernel
- * @callback: receive callback for valid messages
  * @flags: additional netlink message header flags
- * @query_opts: pointer to &struct batadv_nlquery_opts which is used to save
- *  the current processing state. This is given as arg to @callback
  *
  * Return: 0 on success or negative error value otherwise
  */
-__attribute__ ((visibility ("default")))
-int batadv_genl_query(const char *mesh_iface, enum batadv_nl_commands nl_cmd,
-		      nl_recvmsg_msg_cb_t callback, int flags,
-		      struct batadv_nlquery_opts *query_opts)
+static int session_query_once(struct batadv_genl_session *session,
+			      struct nl_cb *cb, struct nlquery_state *state,
+			      enum batadv_nl_commands nl_cmd, int flags)
 {
-	struct nl_sock *sock;
+	struct batadv_nlquery_opts *query_opts = state->query_opts;
 	struct nl_msg *msg;
-	struct nl_cb *cb;
-	int ifindex;
-	int family;
 	int ret;
 
 	query_opts->err = 0;
+	state->done = false;
 
-	sock = nl_socket_alloc();
-	if (!sock)
-		return -ENOMEM;
-
-	ret = genl_connect(sock);
+	ret = session_connect(session);
 	if (ret < 0) {
 		query_opts->err = ret;
-		goto err_free_sock;
+		return ret;
 	}
 
-	family = genl_ctrl_resolve(sock, BATADV_NL_NAME);
-	if (family < 0) {
-		query_opts->err = -EOPNOTSUPP;
-		goto err_free_sock;
+	msg = nlmsg_alloc();
+	if (!msg) {
+		query_opts->err = -ENOMEM;
+		return query_opts->err;
 	}
 
-	ifindex = if_nametoindex(mesh_iface);
-	if (!ifindex) {
-		query_opts->err = -ENODEV;
-		goto err_free_sock;
+	genlmsg_put(msg, NL_AUTO_PID, NL_AUTO_SEQ, session->family, 0, flags,
+		    nl_cmd, 1);
+
+	nla_put_u32(msg, BATADV_ATTR_MESH_IFINDEX, session->ifindex);
+	ret = nl_send_auto_complete(session->sock, msg);
+	state->seq = nlmsg_hdr(msg)->nlmsg_seq;
+	nlmsg_free(msg);
+
+	if (ret >= 0)
+		ret = nl_recvmsgs(session->sock, cb);
+
+	if (ret < 0 && !query_opts->err)
+		query_opts->err = ret;
+
+	/* Replies which were not consumed (callback stopped early, no dump
+	 * or broken socket) would confuse the next query on this socket
+	 */
+	if (!state->done || !(flags & NLM_F_DUMP))
+		session_disconnect(session);
+
+	return query_opts->err;
+}
+
+/**
+ * session_query() - Send a query over a session, reresolving stale state
+ * @session: session to use
+ * @cb: callbacks allocated by nlquery_cb_alloc() for @state
+ * @state: receive state with callback and query_opts of the query
+ * @nl_cmd: &enum batadv_nl_commands which should be sent to kernel
+ * @flags: additional netlink message header flags
+ *
+ * When the mesh interface or the batadv family went away since they were
+ * resolved (e.g. interface recreated or module reloaded), they are looked up
+ * again and the query is retried once. These errors are reported before
+ * any message is passed to the callback.
+ *
+ * Return: 0 on success or negative error value otherwise
+ */
+static int session_query(struct batadv_genl_session *session,
+			 struct nl_cb *cb, struct nlquery_state *state,
+			 enum batadv_nl_commands nl_cmd, int flags)
+{
+	int ret;
+
+	ret = session_query_once(session, cb, state, nl_cmd, flags);
+	switch (ret) {
+	case -ENODEV:
+		session->ifindex = 0;
+		break;
+	case -ENOENT:
+	case -EOPNOTSUPP:
+		session_disconnect(session);
+		session->family = -1;
+		break;
+	default:
+		return ret;
 	}
 
-	cb = nl_cb_alloc(NL_CB_DEFAULT);
+	return session_query_once(session, cb, state, nl_cmd, flags);
+}
+
+/**
+ * batadv_genl_session_open() - Initialize a persistent netlink session
+ * @session: session to initialize
+ * @mesh_iface: name of the batman-adv mesh interface
+ *
+ * The socket is connected and the family and interface are resolved lazily
+ * by the first query, so opening a session for an interface which does not
+ * exist (yet) is not an error.
+ *
+ * Return: 0 on success or negative error value otherwise
+ */
+__attribute__ ((visibility ("default")))
+int batadv_genl_session_open(struct batadv_genl_session *session,
+			     const char *mesh_iface)
+{
+	session->sock = NULL;
+	session->family = -1;
+	session->ifindex = 0;
+
+	if (strlen(mesh_iface) >= sizeof(session->mesh_iface))
+		return -EINVAL;
+
+	strncpy(session->mesh_iface, mesh_iface, sizeof(session->mesh_iface));
+
+	return 0;
+}
+
+/**
+ * batadv_genl_session_close() - Release all resources of a session
+ * @session: session to close
+ */
+__attribute__ ((visibility ("default")))
+void batadv_genl_session_close(struct batadv_genl_session *session)
+{
+	session_disconnect(session);
+	session->family = -1;
+	session->ifindex = 0;
+}
+
+/**
+ * batadv_genl_session_query() - Start a batman-adv generic netlink query on a
+ *  persistent session
+ * @session: session opened with batadv_genl_session_open()
+ * @nl_cmd: &enum batadv_nl_commands which should be sent to kernel
+ * @callback: receive callback for valid messages
+ * @flags: additional netlink message header flags
+ * @query_opts: pointer to &struct batadv_nlquery_opts which is used to save
+ *  the current processing state. This is given as arg to @callback
+ *
+ * Return: 0 on success or negative error value otherwise
+ */
+__attribute__ ((visibility ("default")))
+int batadv_genl_session_query(struct batadv_genl_session *session,
+			      enum batadv_nl_commands nl_cmd,
+			      nl_recvmsg_msg_cb_t callback, int flags,
+			      struct batadv_nlquery_opts *query_opts)
+{
+	struct nlquery_state state = {
+		.callback = callback,
+		.query_opts = query_opts,
+	};
+	struct nl_cb *cb;
+	int ret;
+
+	cb = nlquery_cb_alloc(&state);
 	if (!cb) {
 		query_opts->err = -ENOMEM;
-		goto err_free_sock;
+		return query_opts->err;
+	}
+
+	ret = session_query(session, cb, &state, nl_cmd, flags);
+	nl_cb_put(cb);
+
+	return ret;
+}
+
+/**
+ * batadv_genl_session_dump() - Run several batman-adv dumps back to back
+ * @session: session opened with batadv_genl_session_open()
+ * @dumps: list of dumps to run, in order
+ * @num: number of entries in @dumps
+ *
+ * Each reply is handed to the callback of the dump its sequence number
+ * belongs to, with the &batadv_nlquery_opts of that dump as argument. The
+ * kernel only allows a single running dump per netlink socket, so the next
+ * request is sent as soon as the previous dump has finished, without any
+ * socket setup or family lookup in between. A failing dump does not stop
+ * the following ones; its error is stored in its &batadv_nlquery_opts->err.
+ *
+ * Return: 0 when all dumps succeeded, error of the first failed dump otherwise
+ */
+__attribute__ ((visibility ("default")))
+int batadv_genl_session_dump(struct batadv_genl_session *session,
+			     const struct batadv_genl_dump dumps[],
+			     size_t num)
+{
+	struct nlquery_state state = {
+		.callback = NULL,
+	};
+	struct nl_cb *cb;
+	int err = 0;
+	int ret;
+	size_t i;
+
+	cb = nlquery_cb_alloc(&state);
+	if (!cb) {
+		for (i = 0; i < num; i++)
+			dumps[i].query_opts->err = -ENOMEM;
+
+		return -ENOMEM;
 	}
 
-	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, callback, query_opts);
-	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, nlquery_stop_cb, query_opts);
-	nl_cb_err(cb, NL_CB_CUSTOM, nlquery_error_cb, query_opts);
+	for (i = 0; i < num; i++) {
+		state.callback = dumps[i].callback;
+		state.query_opts = dumps[i].query_opts;
 
-	msg = nlmsg_alloc();
-	if (!msg) {
-		query_opts->err = -ENOMEM;
-		goto err_free_cb;
+		ret = session_query(session, cb, &state, dumps[i].cmd,
+				    NLM_F_DUMP);
+		if (ret < 0 && !err)
+			err = ret;
 	}
 
-	genlmsg_put(msg, NL_AUTO_PID, NL_AUTO_SEQ, family, 0, flags,
-		    nl_cmd, 1);
+	nl_cb_put(cb);
 
-	nla_put_u32(msg, BATADV_ATTR_MESH_IFINDEX, ifindex);
-	nl_send_auto_complete(sock, msg);
-	nlmsg_free(msg);
+	return err;
+}
+
+/**
+ * batadv_genl_query() - Start a common batman-adv generic netlink query
+ * @mesh_iface: name of the batman-adv mesh interface
+ * @nl_cmd: &enum batadv_nl_commands which should be sent to kernel
+ * @callback: receive callback for valid messages
+ * @flags: additional netlink message header flags
+ * @query_opts: pointer to &struct batadv_nlquery_opts which is used to save
+ *  the current processing state. This is given as arg to @callback
+ *
+ * This uses a temporary session; callers sending more than one query should
+ * keep a &struct batadv_genl_session instead.
+ *
+ * Return: 0 on success or negative error value otherwise
+ */
+__attribute__ ((visibility ("default")))
+int batadv_genl_query(const char *mesh_iface, enum batadv_nl_commands nl_cmd,
+		      nl_recvmsg_msg_cb_t callback, int flags,
+		      struct batadv_nlquery_opts *query_opts)
+{
+	struct nlquery_state state = {
+		.callback = callback,
+		.query_opts = query_opts,
+	};
+	struct batadv_genl_session session;
+	struct nl_cb *cb;
+	int ret;
 
-	nl_recvmsgs(sock, cb);
+	query_opts->err = 0;
 
-err_free_cb:
+	ret = batadv_genl_session_open(&session, mesh_iface);
+	if (ret < 0) {
+		query_opts->err = ret;
+		return ret;
+	}
+
+	cb = nlquery_cb_alloc(&state);
+	if (!cb) {
+		query_opts->err = -ENOMEM;
+		return query_opts->err;
+	}
+
+	ret = session_query_once(&session, cb, &state, nl_cmd, flags);
 	nl_cb_put(cb);
-err_free_sock:
-	nl_socket_free(sock);
+	batadv_genl_session_close(&session);
 
-	return query_opts->err;
+	return ret;
 }
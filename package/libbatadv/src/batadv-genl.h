@@ -28,6 +28,7 @@
 #include <netlink/netlink.h>
 #include <netlink/genl/genl.h>
 #include <netlink/genl/ctrl.h>
+#include <net/if.h>
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -46,6 +47,55 @@ struct batadv_nlquery_opts {
 	int err;
 };
 
+/**
+ * struct batadv_genl_session - persistent generic netlink session
+ *
+ * A session keeps the netlink socket, the resolved batadv family id and the
+ * ifindex of the mesh interface between queries. It must be initialized with
+ * batadv_genl_session_open() and released with batadv_genl_session_close().
+ */
+struct batadv_genl_session {
+	/** @sock: connected generic netlink socket, NULL when disconnected */
+	struct nl_sock *sock;
+
+	/** @family: id of the batadv generic netlink family, <0 if unknown */
+	int family;
+
+	/** @ifindex: ifindex of @mesh_iface, 0 if unknown */
+	unsigned int ifindex;
+
+	/** @mesh_iface: name of the batman-adv mesh interface */
+	char mesh_iface[IF_NAMESIZE];
+};
+
+/**
+ * struct batadv_genl_dump - single dump of batadv_genl_session_dump()
+ */
+struct batadv_genl_dump {
+	/** @cmd: &enum batadv_nl_commands which should be dumped */
+	enum batadv_nl_commands cmd;
+
+	/** @callback: receive callback for valid messages of this dump */
+	nl_recvmsg_msg_cb_t callback;
+
+	/**
+	 * @query_opts: processing state of this dump, given as arg to
+	 *  @callback
+	 */
+	struct batadv_nlquery_opts *query_opts;
+};
+
+/**
+ * struct batadv_genl_attr_spec - attribute requested from batadv_genl_parse()
+ */
+struct batadv_genl_attr_spec {
+	/** @id: &enum batadv_nl_attrs of the requested attribute */
+	enum batadv_nl_attrs id;
+
+	/** @mandatory: message is rejected when the attribute is missing */
+	bool mandatory;
+};
+
 /**
  * BATADV_ARRAY_SIZE() - Get number of items in static array
  * @x: array with known length
@@ -95,8 +145,23 @@ batadv_genl_missing_attrs(struct nlattr *attrs[],
 
 extern struct nla_policy batadv_genl_policy[];
 
+int batadv_genl_parse(struct nl_msg *msg, enum batadv_nl_commands nl_cmd,
+		      const struct batadv_genl_attr_spec spec[],
+		      struct nlattr *attrs[], size_t num);
+
 int batadv_genl_query(const char *mesh_iface, enum batadv_nl_commands nl_cmd,
 		      nl_recvmsg_msg_cb_t callback, int flags,
 		      struct batadv_nlquery_opts *query_opts);
 
+int batadv_genl_session_open(struct batadv_genl_session *session,
+			     const char *mesh_iface);
+void batadv_genl_session_close(struct batadv_genl_session *session);
+int batadv_genl_session_query(struct batadv_genl_session *session,
+			      enum batadv_nl_commands nl_cmd,
+			      nl_recvmsg_msg_cb_t callback, int flags,
+			      struct batadv_nlquery_opts *query_opts);
+int batadv_genl_session_dump(struct batadv_genl_session *session,
+			     const struct batadv_genl_dump dumps[],
+			     size_t num);
+
 #endif /* _BATADV_GENL_H_ */
@@ -0,0 +1,164 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * Benchmark of gluonutil_load_site_config(), built on the build host with
+ * "make bench" in the CMake build directory
+ *
+ * A site.json resembling the configuration of a typical community is
+ * written to SITE_CONFIG_PATH (relative to the working directory). Cold
+ * calls are measured by changing the modification time of the file before
+ * every call, so the configuration is parsed again; warm calls are served
+ * from the cache. The host has no domain configurations, so the domain
+ * lookup and merge are not part of the cold path here.
+ */
+
+#include "libgluonutil.h"
+
+#include <json-c/json.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+
+#define COLD_CALLS 2000
+#define WARM_CALLS 200000
+
+#define NUM_PEERS 12
+#define NUM_MIRRORS 4
+
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void write_site_config(void) {
+	FILE *f = fopen(SITE_CONFIG_PATH, "w");
+	int i;
+
+	if (!f) {
+		perror("fopen");
+		exit(1);
+	}
+
+	fputs("{\"site_code\":\"ffxx\",\"site_name\":\"Freifunk Musterstadt\","
+	      "\"default_domain\":\"ffxx\",\"timezone\":\"CET-1CEST,M3.5.0,M10.5.0/3\","
+	      "\"ntp_servers\":[\"1.ntp.services.ffxx\",\"2.ntp.services.ffxx\"],"
+	      "\"regdom\":\"DE\",\"prefix4\":\"10.111.0.0/18\",\"prefix6\":\"fd01:67c:2ed8:1000::/64\","
+	      "\"extra_prefixes6\":[\"2001:67c:2ed8:1000::/64\"],"
+	      "\"next_node\":{\"name\":[\"nextnode.ffxx\",\"nextnode\",\"nn\"],"
+	      "\"ip4\":\"10.111.0.1\",\"ip6\":\"fd01:67c:2ed8:1000::1\",\"mac\":\"16:41:95:40:f7:dc\"},"
+	      "\"wifi24\":{\"channel\":1,\"ap\":{\"ssid\":\"musterstadt.freifunk.net\",\"owe_ssid\":"
+	      "\"owe.musterstadt.freifunk.net\",\"owe_transition_mode\":true},\"mesh\":{\"id\":"
+	      "\"ueH3uXjdp\",\"mcast_rate\":12000}},"
+	      "\"wifi5\":{\"channel\":44,\"outdoor_chanlist\":\"100-140\",\"ap\":{\"ssid\":"
+	      "\"musterstadt.freifunk.net\"},\"mesh\":{\"id\":\"ueH3uXjdp\",\"mcast_rate\":12000}},"
+	      "\"mesh\":{\"vxlan\":true,\"batman_adv\":{\"routing_algo\":\"BATMAN_IV\",\"gw_sel_class\":20}},"
+	      "\"dns\":{\"cacheentries\":5000,\"servers\":[\"fd01:67c:2ed8:1000::1\"]},"
+	      "\"mesh_vpn\":{\"mtu\":1312,\"pubkey_privacy\":true,\"bandwidth_limit\":{\"enabled\":false,"
+	      "\"ingress\":55000,\"egress\":10000},\"fastd\":{\"methods\":[\"salsa2012+umac\",\"null+salsa2012+umac\"],"
+	      "\"configurable\":true,\"groups\":{\"backbone\":{\"limit\":1,\"peers\":{", f);
+
+	for (i = 0; i < NUM_PEERS; i++)
+		fprintf(f, "%s\"peer%d\":{\"key\":\"%064x\",\"remotes\":[\"\\\"gw%d.musterstadt.freifunk.net\\\" port 10000\","
+			"\"ipv4 \\\"gw%d.musterstadt.freifunk.net\\\" port 10000\"]}",
+			i ? "," : "", i, i * 2654435761u, i, i);
+
+	fputs("}}}}},\"autoupdater\":{\"branch\":\"stable\",\"branches\":{", f);
+
+	for (i = 0; i < 3; i++) {
+		static const char *const branches[] = { "stable", "beta", "experimental" };
+		int j;
+
+		fprintf(f, "%s\"%s\":{\"name\":\"%s\",\"good_signatures\":2,\"mirrors\":[",
+			i ? "," : "", branches[i], branches[i]);
+		for (j = 0; j < NUM_MIRRORS; j++)
+			fprintf(f, "%s\"http://[fd01:67c:2ed8:1000::%d]/firmware/%s/sysupgrade\"",
+				j ? "," : "", j + 1, branches[i]);
+		fputs("],\"pubkeys\":[", f);
+		for (j = 0; j < 3; j++)
+			fprintf(f, "%s\"%064x\"", j ? "," : "", (i + 1) * (j + 7) * 40503u);
+		fputs("]}", f);
+	}
+
+	fputs("}},\"config_mode\":{\"hostname\":{\"optional\":false,\"prefill\":true},"
+	      "\"geo_location\":{\"show_altitude\":false,\"osm\":{\"center\":{\"lat\":52.951947,"
+	      "\"lon\":8.744502},\"zoom\":13}},\"remote_login\":{\"show_password_form\":true,"
+	      "\"min_password_length\":12}},\"poe_passthrough\":false}", f);
+
+	if (fclose(f)) {
+		perror("fclose");
+		exit(1);
+	}
+}
+
+static void touch_site_config(long n) {
+	struct timespec times[2] = {
+		{ .tv_nsec = UTIME_OMIT },
+		{ .tv_sec = 1000000000 + n },
+	};
+
+	if (utimensat(AT_FDCWD, SITE_CONFIG_PATH, times, 0)) {
+		perror("utimensat");
+		exit(1);
+	}
+}
+
+static void load(void) {
+	struct json_object *site = gluonutil_load_site_config();
+
+	if (!site) {
+		fprintf(stderr, "Error: unable to load %s\n", SITE_CONFIG_PATH);
+		exit(1);
+	}
+
+	json_object_put(site);
+}
+
+int main(void) {
+	struct stat st;
+	double cold, warm, t;
+	long i;
+
+	write_site_config();
+	if (stat(SITE_CONFIG_PATH, &st)) {
+		perror("stat");
+		return 1;
+	}
+
+	t = now();
+	for (i = 0; i < COLD_CALLS; i++) {
+		touch_site_config(i);
+		load();
+	}
+	cold = (now() - t) / COLD_CALLS;
+
+	/* the cold loop includes the utimensat() calls, so measure them alone */
+	t = now();
+	for (i = 0; i < COLD_CALLS; i++)
+		touch_site_config(COLD_CALLS + i);
+	cold -= (now() - t) / COLD_CALLS;
+
+	load();
+
+	t = now();
+	for (i = 0; i < WARM_CALLS; i++)
+		load();
+	warm = (now() - t) / WARM_CALLS;
+
+	printf("site.json of %lld bytes: cold %.1f us, warm %.2f us per call\n",
+	       (long long)st.st_size, cold * 1e6, warm * 1e6);
+
+	unlink(SITE_CONFIG_PATH);
+
+	return 0;
+}
@@ -0,0 +1,579 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * Replaces the rules of ebtables chains in-process: The whole table is read
+ * from the kernel, the bodies of the given chains are exchanged in the table
+ * blob and the table is written back in a single EBT_SO_SET_ENTRIES call,
+ * which the kernel applies atomically.
+ *
+ * Other processes (e.g. gluon-arp-limiter and gluon-radv-filterd) modify the
+ * same table, and the kernel does not detect that the copy we have read is
+ * stale. The whole read-modify-write is therefore done while holding the
+ * lock file of ebtables' --concurrent mode, which all writers of the table
+ * take (ebtables-tiny is always run with --concurrent). For writers which
+ * don't lock, the number of rules we have read is passed as num_counters;
+ * the kernel rejects the update if the number has changed in between, in
+ * which case it is retried with a fresh copy. Changes keeping the number of
+ * rules can't be detected this way.
+ *
+ * The counters of the old table are returned by the kernel and written back
+ * for all rules which have been kept.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include <linux/netfilter/x_tables.h>
+
+#include "libgluonutil-ebtables.h"
+
+#define EBT_LOCK_DIR "/var/lib/ebtables"
+#define EBT_LOCK_FILE EBT_LOCK_DIR "/lock"
+
+/* Number of attempts when the table is changed concurrently */
+#define EBT_REPLACE_RETRIES 10
+
+struct ebt_chain_map {
+	size_t old_offset;
+	size_t new_offset;
+};
+
+void gluonutil_ebt_rules_init(struct gluonutil_ebt_rules *rules)
+{
+	rules->data = NULL;
+	rules->len = 0;
+	rules->size = 0;
+	rules->num = 0;
+}
+
+void gluonutil_ebt_rules_free(struct gluonutil_ebt_rules *rules)
+{
+	free(rules->data);
+	gluonutil_ebt_rules_init(rules);
+}
+
+static void *ebt_rules_reserve(struct gluonutil_ebt_rules *rules, size_t len)
+{
+	size_t size = rules->size ? rules->size : 1024;
+	char *data;
+
+	while (rules->len + len > size)
+		size *= 2;
+
+	if (size != rules->size) {
+		data = realloc(rules->data, size);
+		if (!data)
+			return NULL;
+
+		rules->data = data;
+		rules->size = size;
+	}
+
+	data = rules->data + rules->len;
+	memset(data, 0, len);
+	rules->len += len;
+
+	return data;
+}
+
+/*
+ * Appends a rule built from entry with an optional match and a target. The
+ * offsets of entry are filled in. For the standard target, target_data
+ * points to the verdict.
+ */
+int gluonutil_ebt_rules_append(struct gluonutil_ebt_rules *rules,
+			       const struct ebt_entry *entry,
+			       const char *match, const void *match_data,
+			       size_t match_len, const char *target,
+			       const void *target_data, size_t target_len)
+{
+	size_t match_size = match ? XT_ALIGN(match_len) : 0;
+	size_t target_size = XT_ALIGN(target_len);
+	size_t len = sizeof(struct ebt_entry);
+	struct ebt_entry_match *m;
+	struct ebt_entry_target *t;
+	struct ebt_entry *e;
+	char *p;
+
+	if (match)
+		len += sizeof(struct ebt_entry_match) + match_size;
+	len += sizeof(struct ebt_entry_target) + target_size;
+
+	p = ebt_rules_reserve(rules, len);
+	if (!p)
+		return -ENOMEM;
+
+	e = (struct ebt_entry *)p;
+	memcpy(e, entry, sizeof(*e));
+	e->bitmask |= EBT_ENTRY_OR_ENTRIES;
+	p += sizeof(*e);
+
+	if (match) {
+		m = (struct ebt_entry_match *)p;
+		strncpy(m->u.name, match, sizeof(m->u.name) - 1);
+		m->match_size = match_size;
+		memcpy(m->data, match_data, match_len);
+		p += sizeof(*m) + match_size;
+	}
+
+	e->watchers_offset = p - (char *)e;
+	e->target_offset = p - (char *)e;
+
+	t = (struct ebt_entry_target *)p;
+	strncpy(t->u.name, target, sizeof(t->u.name) - 1);
+	t->target_size = target_size;
+	memcpy(t->data, target_data, target_len);
+
+	e->next_offset = len;
+	rules->num++;
+
+	return 0;
+}
+
+static bool ebt_is_chain(const char *p)
+{
+	const struct ebt_entry *e = (const struct ebt_entry *)p;
+
+	return !(e->bitmask & EBT_ENTRY_OR_ENTRIES);
+}
+
+static size_t ebt_item_size(const char *p)
+{
+	if (ebt_is_chain(p))
+		return sizeof(struct ebt_entries);
+	else
+		return ((const struct ebt_entry *)p)->next_offset;
+}
+
+static int ebt_get_table(int fd, const char *table, struct ebt_replace *repl)
+{
+	socklen_t optlen = sizeof(*repl);
+
+	memset(repl, 0, sizeof(*repl));
+	strncpy(repl->name, table, sizeof(repl->name) - 1);
+
+	if (getsockopt(fd, IPPROTO_IP, EBT_SO_GET_INFO, repl, &optlen))
+		return -errno;
+
+	repl->entries = malloc(repl->entries_size);
+	if (!repl->entries)
+		return -ENOMEM;
+
+	repl->num_counters = 0;
+	repl->counters = NULL;
+
+	optlen = sizeof(*repl) + repl->entries_size;
+	if (getsockopt(fd, IPPROTO_IP, EBT_SO_GET_ENTRIES, repl, &optlen)) {
+		int err = -errno;
+		free(repl->entries);
+		repl->entries = NULL;
+		return err;
+	}
+
+	return 0;
+}
+
+/*
+ * Copies the rules of the given chain of table to rules, which must have been
+ * initialized with gluonutil_ebt_rules_init().
+ *
+ * Returns 0 on success or a negative errno value; -ENOENT if the chain does
+ * not exist.
+ */
+int gluonutil_ebt_get_rules(const char *table, const char *chain,
+			    struct gluonutil_ebt_rules *rules)
+{
+	struct ebt_replace repl;
+	bool in_chain = false;
+	size_t pos, len;
+	int ret;
+	int fd;
+	char *p;
+
+	fd = socket(AF_INET, SOCK_RAW | SOCK_CLOEXEC, IPPROTO_RAW);
+	if (fd < 0)
+		return -errno;
+
+	ret = ebt_get_table(fd, table, &repl);
+	if (ret)
+		goto out_close;
+
+	ret = -ENOENT;
+
+	for (pos = 0; pos < repl.entries_size; pos += len) {
+		p = repl.entries + pos;
+		len = ebt_item_size(p);
+
+		if (ebt_is_chain(p)) {
+			if (in_chain)
+				break;
+
+			if (!strncmp(((struct ebt_entries *)p)->name, chain,
+				     EBT_CHAIN_MAXNAMELEN)) {
+				in_chain = true;
+				ret = 0;
+			}
+
+			continue;
+		}
+
+		if (!in_chain)
+			continue;
+
+		char *data = ebt_rules_reserve(rules, len);
+		if (!data) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		memcpy(data, p, len);
+		rules->num++;
+	}
+
+	free(repl.entries);
+out_close:
+	close(fd);
+	return ret;
+}
+
+static const struct gluonutil_ebt_rules *
+ebt_find_rules(const struct ebt_entries *chain, const char *const chains[],
+	       const struct gluonutil_ebt_rules rules[], size_t num)
+{
+	size_t i;
+
+	for (i = 0; i < num; i++) {
+		if (!strncmp(chain->name, chains[i], sizeof(chain->name)))
+			return &rules[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Builds the new table blob: Chain headers and the rules of other chains are
+ * copied, the rules of the replaced chains are exchanged. The new offset of
+ * every chain header is recorded in map for the jump fixups, the new index of
+ * every kept rule in counter_map (-1 for removed rules).
+ */
+static void ebt_build_table(const struct ebt_replace *old, char *entries,
+			   size_t *entries_size, unsigned int *nentries,
+			   struct ebt_chain_map *map, size_t *num_map,
+			   int *counter_map, const char *const chains[],
+			   const struct gluonutil_ebt_rules rules[], size_t num)
+{
+	const struct gluonutil_ebt_rules *replace = NULL;
+	struct ebt_entries *chain;
+	unsigned int old_counters = 0;
+	unsigned int counters = 0;
+	size_t new_pos = 0;
+	size_t pos, len;
+	char *p;
+
+	*num_map = 0;
+
+	for (pos = 0; pos < old->entries_size; pos += len) {
+		p = old->entries + pos;
+		len = ebt_item_size(p);
+
+		if (!ebt_is_chain(p)) {
+			if (replace) {
+				counter_map[old_counters++] = -1;
+				continue;
+			}
+
+			counter_map[old_counters++] = counters;
+			if (entries)
+				memcpy(entries + new_pos, p, len);
+			new_pos += len;
+			counters++;
+			continue;
+		}
+
+		map[*num_map].old_offset = pos;
+		map[*num_map].new_offset = new_pos;
+		(*num_map)++;
+
+		replace = ebt_find_rules((const struct ebt_entries *)p,
+					 chains, rules, num);
+
+		if (entries) {
+			chain = (struct ebt_entries *)(entries + new_pos);
+			memcpy(chain, p, len);
+			chain->counter_offset = counters;
+			if (replace)
+				chain->nentries = replace->num;
+		}
+		new_pos += len;
+
+		if (replace) {
+			if (entries && replace->len)
+				memcpy(entries + new_pos, replace->data, replace->len);
+			new_pos += replace->len;
+			counters += replace->num;
+		}
+	}
+
+	*entries_size = new_pos;
+	*nentries = counters;
+}
+
+static int ebt_fixup_table(struct ebt_replace *repl,
+			   const struct ebt_chain_map *map, size_t num_map)
+{
+	struct ebt_standard_target *t;
+	unsigned int hook = 0;
+	struct ebt_entry *e;
+	size_t pos, i;
+	char *p;
+
+	for (pos = 0; pos < repl->entries_size; pos += ebt_item_size(p)) {
+		p = repl->entries + pos;
+
+		if (ebt_is_chain(p)) {
+			/* the builtin chains come first, in hook order */
+			while (hook < NF_BR_NUMHOOKS &&
+			       !(repl->valid_hooks & (1 << hook)))
+				hook++;
+			if (hook < NF_BR_NUMHOOKS)
+				repl->hook_entry[hook++] = (struct ebt_entries *)p;
+
+			continue;
+		}
+
+		e = (struct ebt_entry *)p;
+		t = (struct ebt_standard_target *)ebt_get_target(e);
+		if (strcmp(t->target.u.name, EBT_STANDARD_TARGET) ||
+		    t->verdict < 0)
+			continue;
+
+		/* jumps are offsets of the target chain header */
+		for (i = 0; i < num_map; i++) {
+			if (map[i].old_offset == (size_t)t->verdict)
+				break;
+		}
+		if (i == num_map)
+			return -EINVAL;
+
+		t->verdict = map[i].new_offset;
+	}
+
+	return 0;
+}
+
+/*
+ * Writes the counters of the old table, as returned by EBT_SO_SET_ENTRIES,
+ * back to the rules which have been kept. The kernel adds them to the
+ * (zeroed) counters of the new table.
+ */
+static int ebt_restore_counters(int fd, const struct ebt_replace *repl,
+				const struct ebt_counter *old_counters,
+				unsigned int old_nentries,
+				const int *counter_map)
+{
+	struct ebt_replace hdr;
+	struct ebt_counter *counters;
+	unsigned int i;
+	int ret = 0;
+
+	if (!repl->nentries)
+		return 0;
+
+	counters = calloc(repl->nentries, sizeof(*counters));
+	if (!counters)
+		return -ENOMEM;
+
+	for (i = 0; i < old_nentries; i++) {
+		if (counter_map[i] >= 0)
+			counters[counter_map[i]] = old_counters[i];
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.name, repl->name, sizeof(hdr.name));
+	hdr.num_counters = repl->nentries;
+	hdr.counters = counters;
+
+	if (setsockopt(fd, IPPROTO_IP, EBT_SO_SET_COUNTERS, &hdr,
+		       sizeof(hdr) + hdr.num_counters * sizeof(*counters)))
+		ret = -errno;
+
+	free(counters);
+	return ret;
+}
+
+static int ebt_try_replace_chains(int fd, const char *table,
+				  const char *const chains[],
+				  const struct gluonutil_ebt_rules rules[], size_t num)
+{
+	struct ebt_counter *old_counters = NULL;
+	struct ebt_chain_map *map = NULL;
+	int *counter_map = NULL;
+	struct ebt_replace repl;
+	char *entries = NULL;
+	unsigned int old_nentries;
+	size_t entries_size;
+	unsigned int nentries;
+	size_t num_map, i;
+	int ret;
+
+	ret = ebt_get_table(fd, table, &repl);
+	if (ret)
+		return ret;
+
+	old_nentries = repl.nentries;
+
+	/* there can't be more chains than items in the table */
+	map = calloc(repl.entries_size / sizeof(struct ebt_entries) + 1,
+		     sizeof(*map));
+	counter_map = calloc(old_nentries + 1, sizeof(*counter_map));
+	old_counters = calloc(old_nentries + 1, sizeof(*old_counters));
+	if (!map || !counter_map || !old_counters) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	ebt_build_table(&repl, NULL, &entries_size, &nentries, map, &num_map,
+			counter_map, chains, rules, num);
+
+	for (i = 0; i < num; i++) {
+		size_t j;
+
+		for (j = 0; j < num_map; j++) {
+			const struct ebt_entries *chain = (const struct ebt_entries *)
+				(repl.entries + map[j].old_offset);
+
+			if (!strncmp(chain->name, chains[i], sizeof(chain->name)))
+				break;
+		}
+
+		if (j == num_map) {
+			ret = -ENOENT;
+			goto out_free;
+		}
+	}
+
+	entries = malloc(entries_size);
+	if (!entries) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	ebt_build_table(&repl, entries, &entries_size, &nentries, map,
+			&num_map, counter_map, chains, rules, num);
+
+	free(repl.entries);
+	repl.entries = entries;
+	repl.entries_size = entries_size;
+	repl.nentries = nentries;
+
+	ret = ebt_fixup_table(&repl, map, num_map);
+	if (ret)
+		goto out_free;
+
+	/*
+	 * The kernel refuses the update with EINVAL if the number of rules
+	 * has been changed by a writer which doesn't take the lock
+	 */
+	repl.num_counters = old_nentries;
+	repl.counters = old_counters;
+
+	if (setsockopt(fd, IPPROTO_IP, EBT_SO_SET_ENTRIES, &repl,
+		       sizeof(repl) + repl.entries_size)) {
+		ret = -errno;
+		goto out_free;
+	}
+
+	/*
+	 * The rules are in place at this point, so a failure is not returned
+	 * (and the update is not retried); only the counters are lost then
+	 */
+	ebt_restore_counters(fd, &repl, old_counters, old_nentries, counter_map);
+
+out_free:
+	free(old_counters);
+	free(counter_map);
+	free(map);
+	free(repl.entries);
+	return ret;
+}
+
+/*
+ * Takes the lock of ebtables' --concurrent mode, creating the lock file if
+ * necessary. The lock is released by closing the returned file descriptor.
+ *
+ * Returns the file descriptor or a negative errno value.
+ */
+static int ebt_lock(void)
+{
+	bool created_dir = false;
+	int fd, ret;
+
+	while ((fd = open(EBT_LOCK_FILE, O_RDONLY | O_CREAT | O_CLOEXEC, 0600)) < 0) {
+		if (errno != ENOENT || created_dir)
+			return -errno;
+
+		if (mkdir(EBT_LOCK_DIR, 0700) && errno != EEXIST)
+			return -errno;
+
+		created_dir = true;
+	}
+
+	while (flock(fd, LOCK_EX)) {
+		if (errno == EINTR)
+			continue;
+
+		ret = -errno;
+		close(fd);
+		return ret;
+	}
+
+	return fd;
+}
+
+/*
+ * Replaces the rules of each of the given chains of table by the respective
+ * rules in one atomic table update.
+ *
+ * Returns 0 on success or a negative errno value; -ENOENT if one of the
+ * chains does not exist.
+ */
+int gluonutil_ebt_replace_chains(const char *table, const char *const chains[],
+				 const struct gluonutil_ebt_rules rules[], size_t num)
+{
+	unsigned int i;
+	int lock_fd;
+	int ret;
+	int fd;
+
+	lock_fd = ebt_lock();
+	if (lock_fd < 0)
+		return lock_fd;
+
+	fd = socket(AF_INET, SOCK_RAW | SOCK_CLOEXEC, IPPROTO_RAW);
+	if (fd < 0) {
+		ret = -errno;
+		goto out_unlock;
+	}
+
+	for (i = 0; i < EBT_REPLACE_RETRIES; i++) {
+		ret = ebt_try_replace_chains(fd, table, chains, rules, num);
+		if (ret != -EINVAL)
+			break;
+	}
+
+	close(fd);
+
+out_unlock:
+	close(lock_fd);
+	return ret;
+}
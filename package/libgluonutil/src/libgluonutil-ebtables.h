@@ -0,0 +1,37 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _LIBGLUONUTIL_EBTABLES_H_
+#define _LIBGLUONUTIL_EBTABLES_H_
+
+#include <stddef.h>
+#include <linux/netfilter_bridge/ebtables.h>
+
+/*
+ * In-process access to the rules of ebtables chains, shared by the daemons
+ * which manage chains of the filter table
+ */
+
+/* rules of a single chain, in the kernel's table format */
+struct gluonutil_ebt_rules {
+	char *data;
+	size_t len;
+	size_t size;
+	unsigned int num;
+};
+
+void gluonutil_ebt_rules_init(struct gluonutil_ebt_rules *rules);
+void gluonutil_ebt_rules_free(struct gluonutil_ebt_rules *rules);
+int gluonutil_ebt_rules_append(struct gluonutil_ebt_rules *rules,
+			       const struct ebt_entry *entry,
+			       const char *match, const void *match_data,
+			       size_t match_len, const char *target,
+			       const void *target_data, size_t target_len);
+
+int gluonutil_ebt_get_rules(const char *table, const char *chain,
+			    struct gluonutil_ebt_rules *rules);
+int gluonutil_ebt_replace_chains(const char *table, const char *const chains[],
+				 const struct gluonutil_ebt_rules rules[], size_t num);
+
+#endif /* _LIBGLUONUTIL_EBTABLES_H_ */
@@ -31,6 +31,8 @@
 
 #include <arpa/inet.h>
 
+#include <sys/stat.h>
+
 #include <errno.h>
 #include <glob.h>
 #include <limits.h>
@@ -39,6 +41,13 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+
+/* Can be overridden to run the benchmark on the build host */
+#ifndef SITE_CONFIG_PATH
+#define SITE_CONFIG_PATH "/lib/gluon/site.json"
+#endif
+#define GLUON_UCI_CONFIG_PATH "/etc/config/gluon"
+
 /**
  * Merges two JSON objects
  *
@@ -325,35 +334,207 @@ char * gluonutil_get_primary_domain(void) {
 }
 
 
-struct json_object * gluonutil_load_site_config(void) {
-	char *domain_code = NULL;
+struct file_stamp {
+	bool exists;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+};
+
+/**
+ * Updates a file stamp, returns true if the file has changed since the last
+ * update (or since it was created/removed)
+ */
+static bool file_stamp_update(struct file_stamp *stamp, const char *path) {
+	struct file_stamp cur = {};
+	struct stat st;
+
+	if (stat(path, &st) == 0) {
+		cur.exists = true;
+		cur.dev = st.st_dev;
+		cur.ino = st.st_ino;
+		cur.size = st.st_size;
+		cur.mtime = st.st_mtim;
+	}
+
+	bool changed = (
+		cur.exists != stamp->exists ||
+		cur.dev != stamp->dev ||
+		cur.ino != stamp->ino ||
+		cur.size != stamp->size ||
+		cur.mtime.tv_sec != stamp->mtime.tv_sec ||
+		cur.mtime.tv_nsec != stamp->mtime.tv_nsec
+	);
+
+	*stamp = cur;
+	return changed;
+}
+
+struct gluonutil_json_cache_state {
+	char *json;
+	struct timespec expires;
+	size_t n_files;
+	struct file_stamp stamps[];
+};
+
+void gluonutil_json_cache_invalidate(struct gluonutil_json_cache *cache) {
+	if (!cache->state)
+		return;
+
+	free(cache->state->json);
+	cache->state->json = NULL;
+}
+
+/**
+ * Returns the cached object, or builds and caches it when the cache is empty,
+ * expired or one of its files has changed
+ *
+ * As respondd merges the returned objects destructively, a new object is
+ * returned on every call; on cache hits, it is parsed from the serialized
+ * form.
+ */
+struct json_object * gluonutil_json_cache_get(struct gluonutil_json_cache *cache, struct json_object * (*build)(void)) {
+	struct gluonutil_json_cache_state *state = cache->state;
+	struct timespec now;
+	bool valid;
+	size_t i;
+
+	if (!state) {
+		size_t n_files = 0;
+		while (cache->files && cache->files[n_files])
+			n_files++;
+
+		state = calloc(1, sizeof(*state) + n_files * sizeof(state->stamps[0]));
+		if (!state)
+			return build();
+
+		state->n_files = n_files;
+		cache->state = state;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	valid = state->json && (
+		!cache->ttl ||
+		now.tv_sec < state->expires.tv_sec ||
+		(now.tv_sec == state->expires.tv_sec && now.tv_nsec < state->expires.tv_nsec)
+	);
+
+	/* All stamps are updated, so the next call compares against the current state */
+	for (i = 0; i < state->n_files; i++) {
+		if (file_stamp_update(&state->stamps[i], cache->files[i]))
+			valid = false;
+	}
+
+	if (valid) {
+		struct json_object *ret = json_tokener_parse(state->json);
+		if (ret)
+			return ret;
+	}
+
+	gluonutil_json_cache_invalidate(cache);
+
+	struct json_object *ret = build();
+	if (!ret)
+		return NULL;
+
+	state->json = strdup(json_object_to_json_string_ext(ret, JSON_C_TO_STRING_PLAIN));
+	state->expires = now;
+	state->expires.tv_sec += cache->ttl;
+
+	return ret;
+}
+
+static char * get_domain_path(void) {
+	char *domain_code = gluonutil_get_domain();
+	if (!domain_code)
+		return NULL;
+
+	const char *domain_path_fmt = "/lib/gluon/domains/%s.json";
+	char *domain_path = malloc(strlen(domain_path_fmt) + strlen(domain_code));
+	if (domain_path)
+		sprintf(domain_path, domain_path_fmt, domain_code);
+
+	free(domain_code);
+	return domain_path;
+}
+
+static struct json_object * load_site_config(const char *domain_path) {
 	struct json_object *site = NULL, *domain = NULL;
 
-	site = json_object_from_file("/lib/gluon/site.json");
+	site = json_object_from_file(SITE_CONFIG_PATH);
 	if (!site)
 		return NULL;
 
-	if (!gluonutil_has_domains())
+	if (!domain_path)
 		return site;
 
-	domain_code = gluonutil_get_domain();
-	if (!domain_code)
-		goto err;
+	domain = json_object_from_file(domain_path);
+	if (!domain) {
+		json_object_put(site);
+		return NULL;
+	}
 
-	{
-		const char *domain_path_fmt = "/lib/gluon/domains/%s.json";
-		char domain_path[strlen(domain_path_fmt) + strlen(domain_code)];
-		snprintf(domain_path, sizeof(domain_path), domain_path_fmt, domain_code);
-		free(domain_code);
+	return merge_json(site, domain);
+}
 
-		domain = json_object_from_file(domain_path);
+/**
+ * Returns the site configuration, merged with the configuration of the
+ * selected domain
+ *
+ * The merged configuration is cached for the lifetime of the process and only
+ * reloaded when site.json, the domain configuration or the gluon UCI config
+ * (which selects the domain) change. The returned object is shared and must
+ * not be modified; the caller must release it with json_object_put().
+ */
+struct json_object * gluonutil_load_site_config(void) {
+	static struct {
+		struct json_object *site;
+		bool has_domains;
+		char *domain_path;
+		struct file_stamp site_stamp;
+		struct file_stamp uci_stamp;
+		struct file_stamp domain_stamp;
+	} cache;
+
+	bool changed = file_stamp_update(&cache.site_stamp, SITE_CONFIG_PATH);
+
+	bool has_domains = gluonutil_has_domains();
+	if (has_domains != cache.has_domains) {
+		cache.has_domains = has_domains;
+		changed = true;
 	}
-	if (!domain)
+
+	if (has_domains) {
+		if (file_stamp_update(&cache.uci_stamp, GLUON_UCI_CONFIG_PATH) || !cache.domain_path) {
+			free(cache.domain_path);
+			cache.domain_path = get_domain_path();
+			if (!cache.domain_path)
+				goto err;
+
+			changed = true;
+		}
+
+		if (file_stamp_update(&cache.domain_stamp, cache.domain_path))
+			changed = true;
+	}
+
+	if (!changed && cache.site)
+		return json_object_get(cache.site);
+
+	json_object_put(cache.site);
+	cache.site = load_site_config(has_domains ? cache.domain_path : NULL);
+	if (!cache.site)
 		goto err;
 
-	return merge_json(site, domain);
+	return json_object_get(cache.site);
 
 err:
-	json_object_put(site);
+	/* Force a reload on the next call */
+	json_object_put(cache.site);
+	cache.site = NULL;
+	free(cache.domain_path);
+	cache.domain_path = NULL;
 	return NULL;
 }
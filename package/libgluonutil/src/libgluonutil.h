@@ -30,6 +30,7 @@
 #include <net/if.h>
 #include <netinet/in.h>
 #include <stdbool.h>
+#include <time.h>
 
 
 char * gluonutil_read_line(const char *filename);
@@ -52,6 +53,29 @@ bool gluonutil_get_node_prefix6(struct in6_addr *prefix);
 struct json_object * gluonutil_wrap_string(const char *str);
 struct json_object * gluonutil_wrap_and_free_string(char *str);
 
+/* Default lifetime of cached respondd responses (in seconds) */
+#define GLUONUTIL_JSON_CACHE_TTL 300
+
+struct gluonutil_json_cache_state;
+
+/**
+ * Cache for a JSON object which is expensive to build
+ *
+ * The object is stored in serialized form and rebuilt when the TTL has
+ * expired or one of the given files has changed.
+ */
+struct gluonutil_json_cache {
+	/* Lifetime of the cached object in seconds, 0 for no limit */
+	time_t ttl;
+	/* NULL-terminated list of files whose modification invalidates the cache, may be NULL */
+	const char *const *files;
+
+	struct gluonutil_json_cache_state *state;
+};
+
+struct json_object * gluonutil_json_cache_get(struct gluonutil_json_cache *cache, struct json_object * (*build)(void));
+void gluonutil_json_cache_invalidate(struct gluonutil_json_cache *cache);
+
 bool gluonutil_has_domains(void);
 char * gluonutil_get_domain(void);
 struct json_object * gluonutil_load_site_config(void);